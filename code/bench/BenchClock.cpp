@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "Clock.h"
+
+
+// Cost of one ClockTick() read with each clock source. A source the machine lacks falls back the
+// way ClockInit does, so the row names the source that was actually timed.
+//
+// usage: BenchClock [reads per source]
+
+// Keeps the reads from being optimized away
+static volatile unsigned long long qwSink;
+
+static const char *SourceName(ClockSource source)
+{
+	switch (source) {
+	case CLOCK_SOURCE_TSC:
+		return "rdtsc";
+	case CLOCK_SOURCE_TSCP:
+		return "rdtscp";
+	case CLOCK_SOURCE_SYSTEM:
+#if defined(_WIN32)
+		return "QueryPerformanceCounter";
+#else
+		return "clock_gettime";
+#endif
+	default:
+		return "auto";
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const ClockSource sources[] = { CLOCK_SOURCE_TSC, CLOCK_SOURCE_TSCP, CLOCK_SOURCE_SYSTEM, CLOCK_SOURCE_AUTO };
+
+	int nReads = argc > 1 ? atoi(argv[1]) : 10000000;
+
+	printf("%d reads per source\n", nReads);
+	printf("%-14s %-24s %10s\n", "requested", "timed", "ns/read");
+
+	for (ClockSource requested : sources) {
+		ClockSource source = ClockInit(requested);
+		unsigned long long qwSum = 0;
+
+		auto begin = std::chrono::steady_clock::now();
+
+		for (int nRead = 0; nRead < nReads; nRead++) {
+			qwSum += ClockTick();
+		}
+
+		double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		qwSink = qwSum;
+
+		printf("%-14s %-24s %10.2f\n", SourceName(requested), SourceName(source), fSeconds * 1e9 / nReads);
+	}
+
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "CallTree.h"
+#include "Clock.h"
+
+
+// Cost of one enter, leave or allocation callback with 1 to 256 frames on the shadow stack. The
+// frames hold their call tree node, so none of them should depend on the depth.
+//
+// usage: BenchDepth [callbacks per depth]
+
+#define BENCH_METHODS 64
+
+static double Seconds(std::chrono::steady_clock::time_point begin)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char **argv)
+{
+	int nCallbacks = argc > 1 ? atoi(argv[1]) : 4000000;
+
+	ClockInit(CLOCK_SOURCE_AUTO);
+
+	printf("%d callbacks per depth\n", nCallbacks);
+	printf("%8s %16s %16s\n", "depth", "enter+leave ns", "allocation ns");
+
+	for (DWORD dwDepth = 1; dwDepth <= 256; dwDepth *= 2) {
+		CallTree callTree;
+		MethodStack *pMethodStack = new MethodStack;
+
+		CreateCallTree(callTree);
+
+		// The timed enter lands one above these, allocations are recorded at exactly dwDepth
+		for (DWORD dwFrame = 0; dwFrame < dwDepth; dwFrame++) {
+			EnterMethod(*pMethodStack, &callTree, dwFrame % BENCH_METHODS + 1, ClockTick());
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+
+		for (int nCallback = 0; nCallback < nCallbacks; nCallback += 2) {
+			DWORD dwMethodID = nCallback % BENCH_METHODS + 1;
+
+			EnterMethod(*pMethodStack, &callTree, dwMethodID, ClockTick());
+			LeaveMethod(*pMethodStack, dwMethodID, ClockTick());
+		}
+
+		double fEnterLeave = Seconds(begin);
+
+		begin = std::chrono::steady_clock::now();
+
+		for (int nCallback = 0; nCallback < nCallbacks; nCallback++) {
+			RecordAllocation(callTree, *pMethodStack, nCallback % 16 + 1, 32, 1.0);
+		}
+
+		double fAllocation = Seconds(begin);
+
+		printf("%8u %16.1f %16.1f\n", dwDepth, fEnterLeave * 1e9 / nCallbacks, fAllocation * 1e9 / nCallbacks);
+
+		DestroyCallTree(callTree);
+		delete pMethodStack;
+	}
+
+	return 0;
+}
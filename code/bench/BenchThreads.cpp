@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CallTree.h"
+#include "Clock.h"
+
+
+// Events per second with 1 to 32 recording threads. "thread" gives every thread its own call tree and
+// shadow stack, the way the profiler records. "shared" puts one tree and one lock behind all threads,
+// the way it recorded before the samples moved to TLS. Both pay the epoch claim every callback makes.
+//
+// usage: BenchThreads [events per thread]
+
+#define BENCH_DEPTH 8
+#define BENCH_METHODS 64
+
+static std::mutex mutex;
+
+// The thread's sample epoch on its own cache line, as in ThreadSamples
+typedef struct alignas(CACHE_LINE_SIZE) BenchEpoch {
+	BenchEpoch(void)
+		: nEpoch(0)
+	{
+
+	}
+
+	std::atomic<long> nEpoch;
+} BenchEpoch;
+
+// Same claim as BeginSample/EndSample in MonoProfiler.cpp: a compare-exchange from even to odd, then an increment
+static void BeginSample(BenchEpoch &epoch)
+{
+	while (true) {
+		long nEpoch = epoch.nEpoch;
+
+		if ((nEpoch & 1) == 0 && epoch.nEpoch.compare_exchange_strong(nEpoch, nEpoch + 1)) {
+			break;
+		}
+	}
+}
+
+static void EndSample(BenchEpoch &epoch)
+{
+	epoch.nEpoch++;
+}
+
+// One enter/leave pattern per round, a few hundred distinct call paths in all
+static void RecordEvents(CallTree &callTree, MethodStack &methodStack, BenchEpoch &epoch, std::mutex *pMutex, int nEvents)
+{
+	for (int nRound = 0; nRound * BENCH_DEPTH * 2 < nEvents; nRound++) {
+		for (DWORD dwDepth = 0; dwDepth < BENCH_DEPTH; dwDepth++) {
+			DWORD dwMethodID = (nRound * 7 + dwDepth * 13) % BENCH_METHODS + 1;
+
+			BeginSample(epoch);
+			if (pMutex) pMutex->lock();
+			EnterMethod(methodStack, &callTree, dwMethodID, ClockTick());
+			if (pMutex) pMutex->unlock();
+			EndSample(epoch);
+		}
+
+		for (DWORD dwDepth = BENCH_DEPTH; dwDepth > 0; dwDepth--) {
+			DWORD dwMethodID = (nRound * 7 + (dwDepth - 1) * 13) % BENCH_METHODS + 1;
+
+			BeginSample(epoch);
+			if (pMutex) pMutex->lock();
+			LeaveMethod(methodStack, dwMethodID, ClockTick());
+			if (pMutex) pMutex->unlock();
+			EndSample(epoch);
+		}
+	}
+}
+
+static double Run(int nThreads, int nEvents, bool bShared)
+{
+	std::vector<CallTree> callTrees(bShared ? 1 : nThreads);
+	std::vector<MethodStack*> methodStacks;
+	std::vector<BenchEpoch*> epochs;
+	std::vector<std::thread> threads;
+
+	for (auto &itCallTree : callTrees) {
+		CreateCallTree(itCallTree);
+	}
+
+	for (int nThread = 0; nThread < nThreads; nThread++) {
+		methodStacks.push_back(new MethodStack);
+		epochs.push_back(new BenchEpoch);
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+
+	for (int nThread = 0; nThread < nThreads; nThread++) {
+		CallTree *pCallTree = &callTrees[bShared ? 0 : nThread];
+		MethodStack *pMethodStack = methodStacks[nThread];
+		BenchEpoch *pEpoch = epochs[nThread];
+
+		// The shared tree keeps one stack and epoch per thread too, only the tree is contended
+		threads.push_back(std::thread([=]() { RecordEvents(*pCallTree, *pMethodStack, *pEpoch, bShared ? &mutex : NULL, nEvents); }));
+	}
+
+	for (auto &itThread : threads) {
+		itThread.join();
+	}
+
+	double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	for (auto &itCallTree : callTrees) {
+		DestroyCallTree(itCallTree);
+	}
+
+	for (const auto &itMethodStack : methodStacks) {
+		delete itMethodStack;
+	}
+
+	for (const auto &itEpoch : epochs) {
+		delete itEpoch;
+	}
+
+	return (double)nThreads * nEvents / fSeconds;
+}
+
+int main(int argc, char **argv)
+{
+	int nEvents = argc > 1 ? atoi(argv[1]) : 2000000;
+
+	ClockInit(CLOCK_SOURCE_AUTO);
+
+	printf("%d events per thread, %u hardware threads\n", nEvents, std::thread::hardware_concurrency());
+	printf("%8s %16s %16s\n", "threads", "thread events/s", "shared events/s");
+
+	for (int nThreads = 1; nThreads <= 32; nThreads *= 2) {
+		double fThread = Run(nThreads, nEvents, false);
+		double fShared = Run(nThreads, nEvents, true);
+
+		printf("%8d %16.0f %16.0f\n", nThreads, fThread, fShared);
+	}
+
+	return 0;
+}
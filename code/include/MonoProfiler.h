@@ -7,11 +7,31 @@
 
 #define EXPORT_API __declspec(dllexport)
 
+#define PROFILER_MODE_INSTRUMENT  0 // Timestamp every enter/leave
+#define PROFILER_MODE_SAMPLING    1 // Keep shadow stacks only, a sampler thread attributes wall time
+#define PROFILER_MODE_STATISTICAL 2 // Mono samples instruction pointers, resolved through JIT code ranges
+
+#define PIPELINE_POLICY_DROP 0 // A full ring drops the event and counts it
+#define PIPELINE_POLICY_SPIN 1 // A full ring makes the thread wait for the aggregator
+
 extern "C"
 {
+	EXPORT_API void SetMode(int nMode, int nFrequency); // Call before Init, nFrequency is in Hz
+	EXPORT_API void SetPipeline(int nRingSize, int nPolicy); // Call before Init, callbacks queue events for an aggregator thread, 0 disables
+	EXPORT_API void SetAllocationSampling(int nMeanBytes); // Sample about one allocation per nMeanBytes, 0 records every allocation
+	EXPORT_API void AddFilter(const char *szPattern, bool bInclude); // Glob or prefix of "Namespace::Class::Method", the last matching rule wins
+	EXPORT_API void ClearFilters(void);
 	EXPORT_API void Init(const char *szMonoModuleName);
 	EXPORT_API void Clear(void);
+	EXPORT_API void SetDumpLimits(int nTopCount, float fMinShare); // Dump keeps the top nTopCount entries of each section (0 keeps all) with at least fMinShare of its total
 	EXPORT_API void Dump(const char *szDumpFileName, bool bDetails);
+	EXPORT_API int DumpAsync(const char *szDumpFileName, bool bDetails); // Snapshots and returns, the report is written on a worker thread
+	EXPORT_API bool IsDumpDone(int nDumpID); // True once the report of the DumpAsync returning nDumpID is on disk
+	EXPORT_API void DumpDelta(const char *szDumpFileName, bool bDetails); // Reports only what was recorded since the previous dump
+	EXPORT_API void StartTrace(const char *szTraceFileName, int nMaxSizeMB); // Records every event into a binary trace, see TraceFormat.h
+	EXPORT_API void StopTrace(void);
+	EXPORT_API void StartAutoDump(const char *szFilePrefix, int nIntervalSeconds, int nKeepCount, bool bDetails); // Writes a report of each interval to <prefix>_YYYYMMDD_HHMMSS.xml, keeping the newest nKeepCount files (0 keeps all)
+	EXPORT_API void StopAutoDump(void);
 }
 
 #endif
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "Arena.h"
+
+
+static ArenaBlock* AllocBlock(size_t nSize)
+{
+#if defined(_WIN32)
+	return (ArenaBlock *)VirtualAlloc(NULL, nSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	return (ArenaBlock *)malloc(nSize);
+#endif
+}
+
+static void FreeBlock(ArenaBlock *pBlock)
+{
+#if defined(_WIN32)
+	VirtualFree(pBlock, 0, MEM_RELEASE);
+#else
+	free(pBlock);
+#endif
+}
+
+static const size_t nHeaderSize = (sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+static void UseBlock(Arena &arena, ArenaBlock *pBlock)
+{
+	arena.pCurrent = pBlock;
+	arena.pCursor = (char *)pBlock + nHeaderSize;
+	arena.pLimit = (char *)pBlock + pBlock->nSize;
+}
+
+static size_t AlignmentPadding(const char *pCursor, size_t nAlignment)
+{
+	return (nAlignment - ((size_t)pCursor & (nAlignment - 1))) & (nAlignment - 1);
+}
+
+void* ArenaAlloc(Arena &arena, size_t nSize, size_t nAlignment)
+{
+	nAlignment = nAlignment > ARENA_ALIGNMENT ? nAlignment : ARENA_ALIGNMENT;
+	nSize = (nSize + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+	if (arena.pCursor == NULL || (size_t)(arena.pLimit - arena.pCursor) < AlignmentPadding(arena.pCursor, nAlignment) + nSize) {
+		size_t nBlockSize = nHeaderSize + nAlignment - ARENA_ALIGNMENT + nSize;
+		ArenaBlock *pNext = arena.pCurrent ? arena.pCurrent->pNext : arena.pFirst;
+
+		// Blocks kept by a reset are reused in order, one too small for this request is skipped
+		if (pNext == NULL || pNext->nSize < nBlockSize) {
+			nBlockSize = nBlockSize > ARENA_BLOCK_SIZE ? nBlockSize : ARENA_BLOCK_SIZE;
+			ArenaBlock *pBlock = AllocBlock(nBlockSize);
+
+			if (pBlock == NULL) {
+				return NULL;
+			}
+
+			pBlock->nSize = nBlockSize;
+			pBlock->pNext = pNext;
+
+			if (arena.pCurrent) {
+				arena.pCurrent->pNext = pBlock;
+			}
+			else {
+				arena.pFirst = pBlock;
+			}
+
+			arena.nReserved += pBlock->nSize;
+			pNext = pBlock;
+		}
+
+		UseBlock(arena, pNext);
+	}
+
+	size_t nPadding = AlignmentPadding(arena.pCursor, nAlignment);
+	void *pData = arena.pCursor + nPadding;
+	arena.pCursor += nPadding + nSize;
+	arena.nUsed += nPadding + nSize;
+
+	memset(pData, 0, nSize);
+	return pData;
+}
+
+void ArenaReset(Arena &arena)
+{
+	arena.pCurrent = NULL;
+	arena.pCursor = NULL;
+	arena.pLimit = NULL;
+	arena.nUsed = 0;
+}
+
+void ArenaRelease(Arena &arena)
+{
+	while (ArenaBlock *pBlock = arena.pFirst) {
+		arena.pFirst = pBlock->pNext;
+		FreeBlock(pBlock);
+	}
+
+	ArenaReset(arena);
+	arena.nReserved = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// Bump allocator for data that is released all at once. Blocks come straight from the OS,
+// so profiler memory stays out of the heap the application uses and is easy to account for.
+
+#define ARENA_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGNMENT 16
+
+
+typedef struct ArenaBlock {
+	ArenaBlock *pNext;
+	size_t nSize; // Including this header
+} ArenaBlock;
+
+typedef struct Arena {
+	Arena(void)
+		: pFirst(NULL)
+		, pCurrent(NULL)
+		, pCursor(NULL)
+		, pLimit(NULL)
+		, nReserved(0)
+		, nUsed(0)
+	{
+
+	}
+
+	ArenaBlock *pFirst;
+	ArenaBlock *pCurrent;
+	char *pCursor;
+	char *pLimit;
+
+	size_t nReserved; // Bytes held by blocks
+	size_t nUsed; // Bytes handed out since the last reset
+} Arena;
+
+
+void* ArenaAlloc(Arena &arena, size_t nSize, size_t nAlignment = ARENA_ALIGNMENT); // Zero filled, nAlignment is a power of two
+void ArenaReset(Arena &arena); // Constant time, keeps the blocks for reuse
+void ArenaRelease(Arena &arena); // Returns every block to the OS
+
+#endif
@@ -0,0 +1,254 @@
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include "CallTree.h"
+
+
+static_assert(offsetof(MethodSample, children) + 3 * sizeof(MethodSample*) <= CACHE_LINE_SIZE, "The hot part of MethodSample must fit one cache line");
+static_assert(sizeof(MethodSample) == 2 * CACHE_LINE_SIZE, "MethodSample should stay at two cache lines");
+
+static DWORD HashID(DWORD dwID)
+{
+	return dwID * 2654435761u;
+}
+
+static MethodSample* NewMethodSample(CallTree &callTree, DWORD dwMethodID)
+{
+	return new (ArenaAlloc(callTree.arena, sizeof(MethodSample), alignof(MethodSample))) MethodSample(dwMethodID);
+}
+
+void CreateCallTree(CallTree &callTree)
+{
+	callTree.pRoot = NewMethodSample(callTree, 0);
+}
+
+void ClearCallTree(CallTree &callTree)
+{
+	ArenaReset(callTree.arena);
+	callTree.pRoot = NewMethodSample(callTree, 0);
+}
+
+void DestroyCallTree(CallTree &callTree)
+{
+	ArenaRelease(callTree.arena);
+	callTree.pRoot = NULL;
+}
+
+MethodSample* const* GetChildren(const MethodSample *pMethodSample, DWORD &dwCount)
+{
+	if (pMethodSample->childTable) {
+		dwCount = pMethodSample->dwChildMask + 1;
+		return pMethodSample->childTable;
+	}
+	else {
+		dwCount = pMethodSample->dwChildCount;
+		return pMethodSample->children;
+	}
+}
+
+static void InsertChild(MethodSample **childTable, DWORD dwChildMask, MethodSample *pChild)
+{
+	DWORD dwIndex = HashID(pChild->dwMethodID) & dwChildMask;
+
+	while (childTable[dwIndex]) {
+		dwIndex = (dwIndex + 1) & dwChildMask;
+	}
+
+	childTable[dwIndex] = pChild;
+}
+
+MethodSample* GetChild(CallTree &callTree, MethodSample *pMethodSample, DWORD dwMethodID)
+{
+	if (pMethodSample->childTable) {
+		for (DWORD dwIndex = HashID(dwMethodID) & pMethodSample->dwChildMask; pMethodSample->childTable[dwIndex]; dwIndex = (dwIndex + 1) & pMethodSample->dwChildMask) {
+			if (pMethodSample->childTable[dwIndex]->dwMethodID == dwMethodID) {
+				return pMethodSample->childTable[dwIndex];
+			}
+		}
+	}
+	else {
+		for (DWORD dwIndex = 0; dwIndex < pMethodSample->dwChildCount; dwIndex++) {
+			if (pMethodSample->children[dwIndex]->dwMethodID == dwMethodID) {
+				return pMethodSample->children[dwIndex];
+			}
+		}
+	}
+
+	MethodSample *pChild = NewMethodSample(callTree, dwMethodID);
+	pChild->pParent = pMethodSample;
+
+	if (pMethodSample->childTable == NULL && pMethodSample->dwChildCount < INLINE_CHILD_COUNT) {
+		pMethodSample->children[pMethodSample->dwChildCount++] = pChild;
+		return pChild;
+	}
+
+	if ((pMethodSample->dwChildCount + 1) * 2 > pMethodSample->dwChildMask + 1) {
+		DWORD dwCount;
+		MethodSample* const* children = GetChildren(pMethodSample, dwCount);
+
+		DWORD dwChildMask = pMethodSample->childTable ? pMethodSample->dwChildMask * 2 + 1 : INITIAL_CHILD_TABLE_SIZE - 1;
+		MethodSample **childTable = (MethodSample **)ArenaAlloc(callTree.arena, sizeof(MethodSample*) * (dwChildMask + 1));
+
+		for (DWORD dwIndex = 0; dwIndex < dwCount; dwIndex++) {
+			if (children[dwIndex]) {
+				InsertChild(childTable, dwChildMask, children[dwIndex]);
+			}
+		}
+
+		pMethodSample->childTable = childTable; // The old table stays in the arena, at most as large as the new one
+		pMethodSample->dwChildMask = dwChildMask;
+	}
+
+	InsertChild(pMethodSample->childTable, pMethodSample->dwChildMask, pChild);
+	pMethodSample->dwChildCount++;
+
+	return pChild;
+}
+
+void CollectMethodSamples(MethodSample *pMethodSample, std::vector<MethodSample*> &methodSamples)
+{
+	DWORD dwCount;
+	MethodSample* const* children = GetChildren(pMethodSample, dwCount);
+
+	for (DWORD dwIndex = 0; dwIndex < dwCount; dwIndex++) {
+		if (children[dwIndex]) {
+			methodSamples.push_back(children[dwIndex]);
+			CollectMethodSamples(children[dwIndex], methodSamples);
+		}
+	}
+}
+
+// Finds or inserts the record of dwClassID, the list is kept sorted so reports list objects by class ID
+static AllocationSample* GetAllocationSample(CallTree &callTree, MethodSample *pMethodSample, DWORD dwClassID, DWORD dwObjectSize)
+{
+	AllocationSample **ppAllocationSample = &pMethodSample->pAllocations;
+
+	while (*ppAllocationSample && (*ppAllocationSample)->dwClassID < dwClassID) {
+		ppAllocationSample = &(*ppAllocationSample)->pNext;
+	}
+
+	if (*ppAllocationSample == NULL || (*ppAllocationSample)->dwClassID != dwClassID) {
+		AllocationSample *pAllocationSample = new (ArenaAlloc(callTree.arena, sizeof(AllocationSample))) AllocationSample(dwClassID);
+		pAllocationSample->dwObjectSize = dwObjectSize;
+		pAllocationSample->pNext = *ppAllocationSample;
+		*ppAllocationSample = pAllocationSample;
+	}
+
+	return *ppAllocationSample;
+}
+
+void MergeMethodSample(CallTree &callTree, MethodSample *pMethodSample, const MethodSample *pOther)
+{
+	pMethodSample->qwTime += pOther->qwTime;
+	pMethodSample->qwSelfTime += pOther->qwSelfTime;
+	pMethodSample->dwCount += pOther->dwCount;
+	pMethodSample->fMemorySize += pOther->fMemorySize;
+	pMethodSample->dwSamples += pOther->dwSamples;
+
+	for (const AllocationSample *pOtherAllocation = pOther->pAllocations; pOtherAllocation; pOtherAllocation = pOtherAllocation->pNext) {
+		AllocationSample *pAllocationSample = GetAllocationSample(callTree, pMethodSample, pOtherAllocation->dwClassID, pOtherAllocation->dwObjectSize);
+		pAllocationSample->fCount += pOtherAllocation->fCount;
+		pAllocationSample->fMemorySize += pOtherAllocation->fMemorySize;
+	}
+
+	DWORD dwCount;
+	MethodSample* const* children = GetChildren(pOther, dwCount);
+
+	for (DWORD dwIndex = 0; dwIndex < dwCount; dwIndex++) {
+		if (children[dwIndex]) {
+			MergeMethodSample(callTree, GetChild(callTree, pMethodSample, children[dwIndex]->dwMethodID), children[dwIndex]);
+		}
+	}
+}
+
+void RecordAllocation(CallTree &callTree, MethodStack &methodStack, DWORD dwClassID, DWORD dwObjectSize, double fWeight)
+{
+	MethodSample *pMethodSample = methodStack.dwDepth ? methodStack.frames[methodStack.dwDepth - 1].pMethodSample : NULL;
+
+	if (pMethodSample) {
+		AllocationSample *pAllocationSample = GetAllocationSample(callTree, pMethodSample, dwClassID, dwObjectSize);
+
+		pMethodSample->fMemorySize += fWeight * dwObjectSize;
+		pAllocationSample->fMemorySize += fWeight * dwObjectSize;
+		pAllocationSample->fCount += fWeight;
+	}
+}
+
+void EnterMethod(MethodStack &methodStack, CallTree *pCallTree, DWORD dwMethodID, unsigned long long qwTick)
+{
+	if (methodStack.dwDepth == MAX_STACK_DEPTH) {
+		methodStack.dwOverflow++;
+		return;
+	}
+
+	MethodSample *pMethodSample = NULL;
+
+	if (pCallTree) {
+		MethodSample *pParent = methodStack.dwDepth ? methodStack.frames[methodStack.dwDepth - 1].pMethodSample : pCallTree->pRoot;
+
+		pMethodSample = GetChild(*pCallTree, pParent, dwMethodID);
+		pMethodSample->dwCount++;
+	}
+
+	methodStack.frames[methodStack.dwDepth] = MethodFrame(dwMethodID, pMethodSample, qwTick);
+	methodStack.dwDepth++;
+}
+
+void UnwindMethods(MethodStack &methodStack, DWORD dwDepth, unsigned long long qwTick)
+{
+	while (methodStack.dwDepth > dwDepth) {
+		const MethodFrame &frame = methodStack.frames[methodStack.dwDepth - 1];
+
+		if (frame.pMethodSample) {
+			// A split may have restarted the frame a little after a queued leave was stamped
+			unsigned long long qwTime = qwTick > frame.qwTick ? qwTick - frame.qwTick : 0;
+
+			frame.pMethodSample->qwTime += qwTime;
+			frame.pMethodSample->qwSelfTime += qwTime > frame.qwChildTime ? qwTime - frame.qwChildTime : 0;
+
+			if (methodStack.dwDepth > 1) {
+				methodStack.frames[methodStack.dwDepth - 2].qwChildTime += qwTime;
+			}
+		}
+
+		methodStack.dwDepth--;
+	}
+}
+
+// Like UnwindMethods without popping, so a frame spanning several generations charges each one its own share
+void SplitMethods(MethodStack &methodStack, unsigned long long qwTick)
+{
+	for (DWORD dwIndex = methodStack.dwDepth; dwIndex > 0; dwIndex--) {
+		MethodFrame &frame = methodStack.frames[dwIndex - 1];
+
+		if (frame.pMethodSample) {
+			unsigned long long qwTime = qwTick > frame.qwTick ? qwTick - frame.qwTick : 0;
+
+			frame.pMethodSample->qwTime += qwTime;
+			frame.pMethodSample->qwSelfTime += qwTime > frame.qwChildTime ? qwTime - frame.qwChildTime : 0;
+
+			if (dwIndex > 1) {
+				methodStack.frames[dwIndex - 2].qwChildTime += qwTime;
+			}
+		}
+
+		frame.qwTick = qwTick;
+		frame.qwChildTime = 0;
+	}
+}
+
+void LeaveMethod(MethodStack &methodStack, DWORD dwMethodID, unsigned long long qwTick)
+{
+	if (methodStack.dwOverflow) {
+		methodStack.dwOverflow--;
+		return;
+	}
+
+	// Frames above the matching one missed their leave (exception unwinding), close them too
+	for (DWORD dwIndex = methodStack.dwDepth; dwIndex > 0; dwIndex--) {
+		if (methodStack.frames[dwIndex - 1].dwMethodID == dwMethodID) {
+			UnwindMethods(methodStack, dwIndex - 1, qwTick);
+			break;
+		}
+	}
+}
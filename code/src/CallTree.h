@@ -0,0 +1,149 @@
+#ifndef _CALL_TREE_H_
+#define _CALL_TREE_H_
+
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+typedef unsigned int DWORD;
+#endif
+
+#include "Arena.h"
+
+// Calling context tree and shadow stack, shared by the profiler and the offline trace analyzer.
+// Every node, child table and allocation record of a tree lives in the tree's arena.
+
+#define CACHE_LINE_SIZE 64
+#define INLINE_CHILD_COUNT 7
+#define INITIAL_CHILD_TABLE_SIZE 16
+#define MAX_STACK_DEPTH 1024
+
+
+typedef struct AllocationSample {
+	AllocationSample(DWORD _dwClassID)
+		: pNext(NULL)
+		, dwClassID(_dwClassID)
+		, dwObjectSize(0)
+		, fCount(0.0)
+		, fMemorySize(0.0)
+	{
+
+	}
+
+	AllocationSample *pNext; // Sorted by class ID
+
+	DWORD dwClassID;
+	DWORD dwObjectSize; // Size of the first object seen
+
+	double fCount; // Estimates, each sampled allocation stands for 1/p allocations
+	double fMemorySize;
+} AllocationSample;
+
+// Two cache lines. Enter and leave only touch the first one: the counters, the child lookup and the
+// first few inline children. Allocation, sampling and report fields follow the remaining inline children.
+typedef struct alignas(CACHE_LINE_SIZE) MethodSample {
+	MethodSample(DWORD _dwMethodID)
+		: dwMethodID(_dwMethodID)
+		, dwCount(0)
+		, qwTime(0)
+		, qwSelfTime(0)
+		, dwChildCount(0)
+		, dwChildMask(0)
+		, childTable(NULL)
+		, children{ NULL }
+		, fMemorySize(0.0)
+		, pAllocations(NULL)
+		, pParent(NULL)
+		, dwSamples(0)
+	{
+
+	}
+
+	DWORD dwMethodID;
+	DWORD dwCount;
+
+	unsigned long long qwTime; // Inclusive clock ticks, converted to seconds by Dump
+	unsigned long long qwSelfTime; // Exclusive of time spent in children
+
+	DWORD dwChildCount;
+	DWORD dwChildMask; // Open-addressed childTable size - 1, children[] is used while childTable is NULL
+	MethodSample **childTable;
+	MethodSample *children[INLINE_CHILD_COUNT];
+
+	double fMemorySize; // Estimated bytes allocated, exact unless allocation sampling is enabled
+	AllocationSample *pAllocations;
+
+	MethodSample *pParent;
+	DWORD dwSamples; // Sampling mode hits with this node on top of the stack
+} MethodSample;
+
+typedef struct CallTree {
+	CallTree(void)
+		: pRoot(NULL)
+	{
+
+	}
+
+	Arena arena;
+	MethodSample *pRoot; // Stands for the thread itself
+} CallTree;
+
+typedef struct MethodFrame {
+	MethodFrame(void)
+		: dwMethodID(0)
+		, pMethodSample(NULL)
+		, qwTick(0)
+		, qwChildTime(0)
+	{
+
+	}
+
+	MethodFrame(DWORD _dwMethodID, MethodSample *_pMethodSample, unsigned long long _qwTick)
+		: dwMethodID(_dwMethodID)
+		, pMethodSample(_pMethodSample)
+		, qwTick(_qwTick)
+		, qwChildTime(0)
+	{
+
+	}
+
+	DWORD dwMethodID;
+	MethodSample *pMethodSample; // NULL in sampling mode
+
+	unsigned long long qwTick; // Entered at
+	unsigned long long qwChildTime; // Inclusive time of the callees that already returned
+} MethodFrame;
+
+// Fixed storage so the sampler thread can read a thread's frames while it pushes and pops them
+typedef struct MethodStack {
+	MethodStack(void)
+		: dwDepth(0)
+		, dwOverflow(0)
+	{
+
+	}
+
+	volatile DWORD dwDepth;
+	DWORD dwOverflow; // Frames entered beyond MAX_STACK_DEPTH, not recorded
+
+	MethodFrame frames[MAX_STACK_DEPTH];
+} MethodStack;
+
+
+void CreateCallTree(CallTree &callTree);
+void ClearCallTree(CallTree &callTree); // Constant time, drops every node and starts over with an empty root
+void DestroyCallTree(CallTree &callTree);
+
+MethodSample* const* GetChildren(const MethodSample *pMethodSample, DWORD &dwCount);
+MethodSample* GetChild(CallTree &callTree, MethodSample *pMethodSample, DWORD dwMethodID); // Finds or inserts, pMethodSample belongs to callTree
+void CollectMethodSamples(MethodSample *pMethodSample, std::vector<MethodSample*> &methodSamples);
+void MergeMethodSample(CallTree &callTree, MethodSample *pMethodSample, const MethodSample *pOther); // Adds pOther's counters and subtree
+
+void RecordAllocation(CallTree &callTree, MethodStack &methodStack, DWORD dwClassID, DWORD dwObjectSize, double fWeight);
+void EnterMethod(MethodStack &methodStack, CallTree *pCallTree, DWORD dwMethodID, unsigned long long qwTick); // pCallTree NULL keeps the shadow stack only
+void LeaveMethod(MethodStack &methodStack, DWORD dwMethodID, unsigned long long qwTick);
+void UnwindMethods(MethodStack &methodStack, DWORD dwDepth, unsigned long long qwTick); // Closes the frames above dwDepth
+void SplitMethods(MethodStack &methodStack, unsigned long long qwTick); // Charges the open frames up to qwTick and restarts them there
+
+#endif
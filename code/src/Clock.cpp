@@ -0,0 +1,142 @@
+#include "Clock.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#if CLOCK_HAS_TSC
+#include <cpuid.h>
+#endif
+#endif
+
+
+ClockSource clockSource = CLOCK_SOURCE_SYSTEM;
+
+static unsigned long long qwSystemFrequency = 0;
+static unsigned long long qwFrequency = 0;
+static double dSecondsPerTick = 0.0;
+
+
+static void cpuid(unsigned int dwLeaf, unsigned int registers[4])
+{
+#if CLOCK_HAS_TSC && defined(_MSC_VER)
+	__cpuid((int *)registers, (int)dwLeaf);
+#elif CLOCK_HAS_TSC
+	__cpuid(dwLeaf, registers[0], registers[1], registers[2], registers[3]);
+#else
+	registers[0] = registers[1] = registers[2] = registers[3] = 0;
+#endif
+}
+
+static bool HasInvariantTSC(void)
+{
+	unsigned int registers[4];
+
+	cpuid(0x80000000, registers);
+	if (registers[0] < 0x80000007) {
+		return false;
+	}
+
+	cpuid(0x80000007, registers);
+	return (registers[3] & (1 << 8)) != 0;
+}
+
+static bool HasRDTSCP(void)
+{
+	unsigned int registers[4];
+
+	cpuid(0x80000000, registers);
+	if (registers[0] < 0x80000001) {
+		return false;
+	}
+
+	cpuid(0x80000001, registers);
+	return (registers[3] & (1 << 27)) != 0;
+}
+
+unsigned long long ClockSystemTick(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return count.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static unsigned long long SystemFrequency(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return freq.QuadPart;
+#else
+	return 1000000000ULL;
+#endif
+}
+
+// Measures the TSC rate against the system clock over ~20ms
+static unsigned long long CalibrateTSC(void)
+{
+#if CLOCK_HAS_TSC
+	unsigned long long qwSystemBegin = ClockSystemTick();
+	unsigned long long qwTSCBegin = __rdtsc();
+	unsigned long long qwSystemEnd;
+
+	do {
+		qwSystemEnd = ClockSystemTick();
+	} while (qwSystemEnd - qwSystemBegin < qwSystemFrequency / 50);
+
+	unsigned long long qwTSCEnd = __rdtsc();
+
+	return (unsigned long long)((double)(qwTSCEnd - qwTSCBegin) * qwSystemFrequency / (qwSystemEnd - qwSystemBegin));
+#else
+	return 0;
+#endif
+}
+
+ClockSource ClockInit(ClockSource source)
+{
+	if (qwSystemFrequency == 0) {
+		qwSystemFrequency = SystemFrequency();
+	}
+
+	if (source == CLOCK_SOURCE_AUTO) {
+		source = CLOCK_HAS_TSC && HasInvariantTSC() ? CLOCK_SOURCE_TSC : CLOCK_SOURCE_SYSTEM;
+	}
+
+	if (source == CLOCK_SOURCE_TSCP && HasRDTSCP() == false) {
+		source = CLOCK_SOURCE_TSC;
+	}
+
+	if (source == CLOCK_SOURCE_TSC || source == CLOCK_SOURCE_TSCP) {
+		static unsigned long long qwTSCFrequency = CalibrateTSC();
+		qwFrequency = qwTSCFrequency;
+	}
+	else {
+		qwFrequency = qwSystemFrequency;
+	}
+
+	if (qwFrequency == 0) {
+		source = CLOCK_SOURCE_SYSTEM;
+		qwFrequency = qwSystemFrequency;
+	}
+
+	dSecondsPerTick = 1.0 / qwFrequency;
+	clockSource = source;
+
+	return source;
+}
+
+unsigned long long ClockFrequency(void)
+{
+	return qwFrequency;
+}
+
+double ClockSeconds(unsigned long long qwTicks)
+{
+	return qwTicks * dSecondsPerTick;
+}
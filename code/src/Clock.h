@@ -0,0 +1,51 @@
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CLOCK_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define CLOCK_HAS_TSC 0
+#endif
+
+
+typedef enum {
+	CLOCK_SOURCE_AUTO = 0,   // Invariant TSC when available, system clock otherwise
+	CLOCK_SOURCE_TSC,        // rdtsc
+	CLOCK_SOURCE_TSCP,       // rdtscp, waits for preceding instructions to retire
+	CLOCK_SOURCE_SYSTEM      // QueryPerformanceCounter on Windows, clock_gettime(CLOCK_MONOTONIC) elsewhere
+} ClockSource;
+
+
+extern ClockSource clockSource;
+
+// Selects and calibrates the clock once, returns the source actually in use.
+ClockSource ClockInit(ClockSource source);
+
+unsigned long long ClockFrequency(void);
+unsigned long long ClockSystemTick(void);
+
+// Ticks are only converted when reporting
+double ClockSeconds(unsigned long long qwTicks);
+
+inline unsigned long long ClockTick(void)
+{
+#if CLOCK_HAS_TSC
+	if (clockSource == CLOCK_SOURCE_TSC) {
+		return __rdtsc();
+	}
+
+	if (clockSource == CLOCK_SOURCE_TSCP) {
+		unsigned int dwAux;
+		return __rdtscp(&dwAux);
+	}
+#endif
+
+	return ClockSystemTick();
+}
+
+#endif
@@ -1,51 +1,224 @@
 #include "_MonoProfiler.h"
 
+#pragma comment(lib, "winmm.lib")
+
 
 #define LOG DebugOut
 
+#define MAX_UNKNOWN_HITS 4096
+
+#define EVENT_ENTER 0
+#define EVENT_LEAVE 1
+#define EVENT_ALLOCATION 2
+
+#define INFO_PAGE_SIZE 4096
+#define INFO_PAGE_COUNT 4096
+
+
+typedef struct EventRecord {
+	DWORD dwType;
+	DWORD dwID; // Method ID, or class ID for allocations
+	unsigned long long qwTick;
+	DWORD dwSize;
+	float fWeight; // Allocation sampling weight
+} EventRecord;
+
+// Single producer (the owner thread), single consumer (the aggregator thread, or Clear/Dump holding mutex)
+typedef struct EventRing {
+	EventRing(void)
+		: records(NULL)
+		, dwMask(0)
+		, dwHead(0)
+		, dwTail(0)
+		, nDropped(0)
+		, nSpins(0)
+	{
 
-typedef struct AllocationSample {
-	AllocationSample(const char *_name)
-		: name{ 0 }
-		, dwCount(0)
-		, dwMemorySize(0)
+	}
+
+	EventRecord *records;
+	DWORD dwMask;
+
+	volatile DWORD dwHead; // Advanced by the consumer
+	volatile DWORD dwTail; // Advanced by the producer
+
+	volatile LONG nDropped; // Records lost to a full ring with PIPELINE_POLICY_DROP
+	volatile LONG nSpins; // Times the producer waited on a full ring with PIPELINE_POLICY_SPIN
+} EventRing;
+
+typedef struct ThreadSamples {
+	ThreadSamples(DWORD _dwThreadID)
+		: dwThreadID(_dwThreadID)
+		, bExited(FALSE)
+		, nEpoch(0)
+		, nAllocationCountdown(0)
+		, dwRandom(_dwThreadID * 2654435761u | 1)
+		, pTraceChunk(NULL)
+		, nTraceSession(0)
+		, qwTraceTick(0)
+		, dwTraceDepth(0)
+	{
+
+	}
+
+	DWORD dwThreadID;
+	volatile LONG bExited; // The thread is gone, the samples wait for the next new thread
+	volatile LONG nEpoch; // Odd while the samples are owned, by the thread inside a callback or by Clear/Dump swapping generations
+
+	MethodStack methodStack;
+	CallTree callTree; // Live generation, written by whoever owns the samples at the time: this thread, the sampler or the aggregator
+	CallTree dumpCallTree; // Every generation retired since the last Clear, owned by the dump thread
+
+	long long nAllocationCountdown; // Bytes left until the next sampled allocation
+	DWORD dwRandom; // xorshift state for the countdown draws
+
+	EventRing eventRing;
+
+	TraceChunkHeader *pTraceChunk; // Chunk being filled in the mapped trace file, NULL when there is none
+	LONG nTraceSession; // Trace the chunk and traceStack belong to
+	unsigned long long qwTraceTick; // Tick of the last event written to the chunk
+	DWORD dwTraceDepth;
+	DWORD traceStack[MAX_STACK_DEPTH]; // Method IDs, kept apart from methodStack so every chunk starts with its own stack
+} ThreadSamples;
+
+typedef std::vector<ThreadSamples*> ThreadSamplesList;
+
+typedef struct MethodInfo {
+	MethodInfo(DWORD _dwID, const char *_name)
+		: dwID(_dwID)
+		, name(_name)
+		, bFiltered(false)
+		, nHits(0)
+		, nTraceSession(0)
+	{
+
+	}
+
+	DWORD dwID;
+	const char *name; // Lives in tableArena
+
+	volatile bool bFiltered; // Cached filter verdict, filtered methods never get a frame
+	volatile LONG nHits; // Statistical mode samples whose IP fell into this method's code
+	volatile LONG nTraceSession; // Last trace the name was written to
+} MethodInfo;
+
+typedef struct ClassInfo {
+	ClassInfo(DWORD _dwID, const char *_name, DWORD _dwInstanceSize, bool _bVariableSize)
+		: dwID(_dwID)
+		, name(_name)
+		, dwInstanceSize(_dwInstanceSize)
+		, bVariableSize(_bVariableSize)
+		, nTraceSession(0)
 	{
-		strcpy(name, _name);
+
 	}
 
-	char name[260];
+	DWORD dwID;
+	const char *name; // Lives in tableArena
+
+	DWORD dwInstanceSize;
+	bool bVariableSize; // Arrays and strings, sized per object by mono_object_get_size
+	volatile LONG nTraceSession; // Last trace the name was written to
+} ClassInfo;
+
+// Interned names, open-addressed by string hash, all in tableArena
+typedef struct NameTable {
+	NameTable(void)
+		: names(NULL)
+		, dwMask(0)
+		, dwCount(0)
+	{
+
+	}
 
+	const char **names;
+	DWORD dwMask;
 	DWORD dwCount;
-	DWORD dwMemorySize;
-} AllocationSample;
-
-typedef struct MethodSample {
-	MethodSample(const char *_name)
-		: pParent(NULL)
-		, name{ 0 }
-		, dwTime(0)
+} NameTable;
+
+typedef struct PointerEntry {
+	const void *volatile key;
+	void *value;
+} PointerEntry;
+
+typedef struct PointerTable {
+	PointerTable(DWORD dwCapacity, PointerTable *_pRetired)
+		: dwMask(dwCapacity - 1)
 		, dwCount(0)
-		, dwMemorySize(0)
-		, dwTick(0)
+		, pRetired(_pRetired)
+	{
+		entries = new PointerEntry[dwCapacity];
+		memset(entries, 0, sizeof(PointerEntry) * dwCapacity);
+	}
+
+	DWORD dwMask;
+	DWORD dwCount;
+	PointerEntry *entries;
+
+	PointerTable *pRetired; // Outgrown tables are kept alive for lock-free readers
+} PointerTable;
+
+typedef struct FilterRule {
+	FilterRule(const char *_pattern, bool _bInclude)
+		: pattern(_pattern)
+		, bInclude(_bInclude)
+	{
+
+	}
+
+	std::string pattern; // Glob with * and ?, or a plain prefix of "Namespace::Class::Method"
+	bool bInclude;
+} FilterRule;
+
+typedef struct JitRange {
+	ULONG_PTR start;
+	ULONG_PTR end;
+	DWORD dwMethodID;
+} JitRange;
+
+// Sorted JIT code ranges plus an Eytzinger (BFS order) copy of their start addresses for the IP search
+typedef struct JitTable {
+	JitTable(JitTable *_pRetired)
+		: pRetired(_pRetired)
 	{
-		strcpy(name, _name);
+
 	}
 
-	MethodSample *pParent;
+	std::vector<JitRange> ranges;
+	std::vector<ULONG_PTR> keys; // 1-based
+	std::vector<DWORD> indices; // [Eytzinger slot, ranges index]
 
-	char name[260];
+	JitTable *pRetired; // Replaced tables are kept until no sampler can still be reading them
+} JitTable;
 
-	DWORD dwTick;
-	DWORD dwTime;
+typedef struct UnknownHit {
+	ULONG_PTR ip;
 	DWORD dwCount;
-	DWORD dwMemorySize;
+} UnknownHit;
+
+
+// Generations retired by one DumpAsync, merged and written in order by the dump thread
+typedef struct DumpRequest {
+	DumpRequest(LONG _nDumpID, const char *_fileName, bool _bDetails, bool _bDelta, bool _bReset)
+		: nDumpID(_nDumpID)
+		, fileName(_fileName)
+		, bDetails(_bDetails)
+		, bDelta(_bDelta)
+		, bReset(_bReset)
+	{
 
-	std::map<DWORD, AllocationSample*> alloctions;
-} MethodSample;
+	}
 
-typedef std::map<DWORD, std::stack<std::string>> MethodStackMap; // [ThreadID, Method Stack]
-typedef std::map<DWORD, std::map<DWORD, MethodSample*>> MethodSampleMap; // [ThreadID, Method Stack Hash, Method Sample]
+	LONG nDumpID;
+	std::string fileName;
+	bool bDetails;
+	bool bDelta; // Report the retired generations alone, what changed since the previous dump
+	bool bReset; // Empty the dump trees and hit counters once written, the next report starts from here
+	ReportLimits limits;
 
+	ThreadSamplesList threads;
+	std::vector<CallTree> callTrees; // One per thread
+} DumpRequest;
 
 typedef void(*MonoProfileMethodFunc)(MonoProfiler *prof, MonoMethod *method);
 typedef void(*MonoProfileGCFunc)(MonoProfiler *prof, MonoGCEvent event, int generation);
@@ -59,309 +232,2092 @@ typedef void(*MonoProfilerInstallGCFunc)(MonoProfileGCFunc callback, MonoProfile
 typedef void(*MonoProfilerInstallAllocation)(MonoProfileAllocFunc callback);
 typedef guint(*MonoObjectGetSize)(MonoObject* o);
 
-
-static PRTL_CRITICAL_SECTION mutex = NULL;
-
-static bool bPause = true;
-static MethodStackMap methodStacks;
-static MethodSampleMap methodSamples;
+typedef void(*MonoProfileStatFunc)(MonoProfiler *prof, guchar *ip, void *context);
+typedef void(*MonoProfileJitResult)(MonoProfiler *prof, MonoMethod *method, MonoJitInfo *jinfo, int result);
+
+typedef void(*MonoProfilerInstallStatistical)(MonoProfileStatFunc callback);
+typedef void(*MonoProfilerInstallJitEnd)(MonoProfileJitResult end);
+typedef gpointer(*MonoJitInfoGetCodeStart)(MonoJitInfo *ji);
+typedef int(*MonoJitInfoGetCodeSize)(MonoJitInfo *ji);
+typedef MonoMethod*(*MonoJitInfoGetMethod)(MonoJitInfo *ji);
+typedef MonoJitInfo*(*MonoJitInfoTableFind)(MonoDomain *domain, char *addr);
+typedef MonoDomain*(*MonoGetRootDomain)(void);
+typedef MonoThread*(*MonoThreadAttach)(MonoDomain *domain);
+typedef void(*MonoThreadDetach)(MonoThread *thread);
+
+typedef const char*(*MonoMethodGetName)(MonoMethod *method);
+typedef MonoClass*(*MonoMethodGetClass)(MonoMethod *method);
+typedef const char*(*MonoClassGetName)(MonoClass *klass);
+typedef const char*(*MonoClassGetNamespace)(MonoClass *klass);
+typedef gint32(*MonoClassInstanceSize)(MonoClass *klass);
+typedef gint32(*MonoClassGetRank)(MonoClass *klass);
+typedef MonoClass*(*MonoGetStringClass)(void);
+typedef MonoClass*(*MonoObjectGetClass)(MonoObject *obj);
+
+// Profiler API of Mono 5.6 and later, callbacks are registered on a handle and call probes are decided at JIT time
+typedef MonoProfilerCallInstrumentationFlags(*MonoProfilerCallInstrumentationFilterCallback)(MonoProfiler *prof, MonoMethod *method);
+typedef void(*MonoProfilerMethodCallback)(MonoProfiler *prof, MonoMethod *method, MonoProfilerCallContext *context);
+typedef void(*MonoProfilerMethodExceptionLeaveCallback)(MonoProfiler *prof, MonoMethod *method, MonoObject *exception);
+typedef void(*MonoProfilerGCAllocationCallback)(MonoProfiler *prof, MonoObject *object);
+typedef void(*MonoProfilerGCEventCallback)(MonoProfiler *prof, MonoGCEvent event, guint32 generation, mono_bool is_serial);
+typedef void(*MonoProfilerJitDoneCallback)(MonoProfiler *prof, MonoMethod *method, MonoJitInfo *jinfo);
+typedef void(*MonoProfilerSampleHitCallback)(MonoProfiler *prof, const guchar *ip, const void *context);
+
+typedef MonoProfilerHandle(*MonoProfilerCreate)(MonoProfiler *prof);
+typedef void(*MonoProfilerSetCallInstrumentationFilterCallback)(MonoProfilerHandle handle, MonoProfilerCallInstrumentationFilterCallback cb);
+typedef void(*MonoProfilerSetMethodEnterCallback)(MonoProfilerHandle handle, MonoProfilerMethodCallback cb);
+typedef void(*MonoProfilerSetMethodLeaveCallback)(MonoProfilerHandle handle, MonoProfilerMethodCallback cb);
+typedef void(*MonoProfilerSetMethodExceptionLeaveCallback)(MonoProfilerHandle handle, MonoProfilerMethodExceptionLeaveCallback cb);
+typedef mono_bool(*MonoProfilerEnableAllocations)(void);
+typedef void(*MonoProfilerSetGCAllocationCallback)(MonoProfilerHandle handle, MonoProfilerGCAllocationCallback cb);
+typedef void(*MonoProfilerSetGCEventCallback)(MonoProfilerHandle handle, MonoProfilerGCEventCallback cb);
+typedef mono_bool(*MonoProfilerEnableSampling)(MonoProfilerHandle handle);
+typedef mono_bool(*MonoProfilerSetSampleMode)(MonoProfilerHandle handle, MonoProfilerSampleMode mode, guint32 freq);
+typedef void(*MonoProfilerSetSampleHitCallback)(MonoProfilerHandle handle, MonoProfilerSampleHitCallback cb);
+typedef void(*MonoProfilerSetJitDoneCallback)(MonoProfilerHandle handle, MonoProfilerJitDoneCallback cb);
+
+
+static PRTL_CRITICAL_SECTION mutex = NULL; // Guards threadSamples, only taken by Init/Clear/Dump and once per new thread
+static PRTL_CRITICAL_SECTION mutexDump = NULL; // Guards dumpRequests and spareCallTrees, taken before mutex
+static PRTL_CRITICAL_SECTION mutexTables = NULL; // Guards inserts into the method/class tables, lookups are lock free
+static DWORD dwTlsIndex = TLS_OUT_OF_INDEXES;
+
+static volatile bool bPause = true;
+static ThreadSamplesList threadSamples;
+
+static PRTL_CRITICAL_SECTION mutexJit = NULL; // Guards jitPending, unknownHits and jitTable rebuilds
+
+static int nProfilerMode = PROFILER_MODE_INSTRUMENT;
+static int nSampleFrequency = 1000;
+static int nAllocationInterval = 0; // Mean bytes between sampled allocations, 0 records every allocation
+static ReportLimits reportLimits;
+static HANDLE hSamplerThread = NULL;
+static volatile LONG bSamplerExit = FALSE;
+
+static int nPipelineSize = 0; // Records per thread ring, 0 updates the samples on the calling thread
+static int nPipelinePolicy = PIPELINE_POLICY_DROP;
+static bool bPipeline = false;
+static HANDLE hAggregatorThread = NULL;
+static volatile LONG bAggregatorExit = FALSE;
+
+static HANDLE hDumpThread = NULL; // Started by the first dump, blocks on hDumpQueued while there is nothing to write
+static HANDLE hDumpQueued = NULL; // Auto-reset, signaled by every queued dump
+static HANDLE hDumpDone = NULL; // Manual-reset, cleared while a dump is written and set once it is done
+static std::vector<DumpRequest*> dumpRequests; // The first one is being written
+static std::vector<CallTree> spareCallTrees; // Emptied generations ready for the next swap
+static volatile LONG nDumpCount = 0; // ID of the last dump requested
+static volatile LONG nDumpsDone = 0; // ID of the last dump written
+static std::vector<LONG> dumpedHits; // Owned by the dump thread, hit counters as of the previous dump, indexed by method ID
+static LONG nDumpedDroppedHits = 0;
+
+static HANDLE hAutoDumpThread = NULL;
+static volatile LONG bAutoDumpExit = FALSE;
+static std::string autoDumpPrefix;
+static int nAutoDumpInterval = 0; // Seconds
+static int nAutoDumpKeep = 0; // Newest files kept, 0 keeps all
+static bool bAutoDumpDetails = false;
+
+static volatile bool bTracing = false;
+static volatile LONG nTraceSession = 0;
+static HANDLE hTraceFile = INVALID_HANDLE_VALUE;
+static HANDLE hTraceMapping = NULL;
+static BYTE *pTraceView = NULL;
+static unsigned long long qwTraceSize = 0;
+static volatile LONGLONG qwTraceOffset = 0; // Next free chunk, threads claim chunks with an atomic add
+static volatile LONG nTraceDropped = 0; // Events lost once the file was full
+
+static Arena tableArena; // Guarded by mutexTables, method/class infos and their names, never reset
+static NameTable nameTable; // Guarded by mutexTables, method and class infos share one copy of each name
+
+static volatile DWORD dwMethodCount = 0; // Published after the info is stored, readers walk 1..count without the lock
+static PointerTable *volatile methodTable = NULL; // [MonoMethod*, MethodInfo*]
+static MethodInfo **methodInfos[INFO_PAGE_COUNT] = { NULL }; // [Method ID, MethodInfo*]
+
+static volatile DWORD dwClassCount = 0; // Published after the info is stored
+static PointerTable *volatile classTable = NULL; // [MonoClass*, ClassInfo*]
+static ClassInfo **classInfos[INFO_PAGE_COUNT] = { NULL }; // [Class ID, ClassInfo*]
+
+static std::vector<FilterRule> filterRules; // Guarded by mutexTables, the last matching rule wins
+
+static JitTable *volatile jitTable = NULL;
+static volatile LONG nJitReaders = 0; // Samplers searching jitTable, retired tables are only freed while there are none
+static std::vector<JitRange> jitPending;
+static UnknownHit unknownHits[MAX_UNKNOWN_HITS] = { 0 }; // Open-addressed by IP, resolved by Dump
+static volatile LONG nDroppedHits = 0; // Statistical samples that could not be attributed to a method
 
 static MonoProfilerInstallEnterLeaveFunc mono_profiler_install_enter_leave = NULL;
 static MonoProfilerSetEventsFunc mono_profiler_set_events = NULL;
 static MonoProfilerInstallGCFunc mono_profiler_install_gc = NULL;
 static MonoProfilerInstallAllocation mono_profiler_install_allocation = NULL;
 static MonoObjectGetSize mono_object_get_size = NULL;
+static MonoProfilerInstallStatistical mono_profiler_install_statistical = NULL;
+static MonoProfilerInstallJitEnd mono_profiler_install_jit_end = NULL;
+static MonoJitInfoGetCodeStart mono_jit_info_get_code_start = NULL;
+static MonoJitInfoGetCodeSize mono_jit_info_get_code_size = NULL;
+static MonoJitInfoGetMethod mono_jit_info_get_method = NULL;
+static MonoJitInfoTableFind mono_jit_info_table_find = NULL;
+static MonoGetRootDomain mono_get_root_domain = NULL;
+static MonoThreadAttach mono_thread_attach = NULL;
+static MonoThreadDetach mono_thread_detach = NULL;
+
+static MonoMethodGetName mono_method_get_name = NULL;
+static MonoMethodGetClass mono_method_get_class = NULL;
+static MonoClassGetName mono_class_get_name = NULL;
+static MonoClassGetNamespace mono_class_get_namespace = NULL;
+static MonoClassInstanceSize mono_class_instance_size = NULL;
+static MonoClassGetRank mono_class_get_rank = NULL;
+static MonoGetStringClass mono_get_string_class = NULL;
+static MonoObjectGetClass mono_object_get_class = NULL;
+
+static MonoProfilerHandle hProfiler = NULL; // Created once, the runtime has no way to destroy a profiler
+static MonoProfilerCreate mono_profiler_create = NULL;
+static MonoProfilerSetCallInstrumentationFilterCallback mono_profiler_set_call_instrumentation_filter_callback = NULL;
+static MonoProfilerSetMethodEnterCallback mono_profiler_set_method_enter_callback = NULL;
+static MonoProfilerSetMethodLeaveCallback mono_profiler_set_method_leave_callback = NULL;
+static MonoProfilerSetMethodExceptionLeaveCallback mono_profiler_set_method_exception_leave_callback = NULL;
+static MonoProfilerEnableAllocations mono_profiler_enable_allocations = NULL;
+static MonoProfilerSetGCAllocationCallback mono_profiler_set_gc_allocation_callback = NULL;
+static MonoProfilerSetGCEventCallback mono_profiler_set_gc_event_callback = NULL;
+static MonoProfilerEnableSampling mono_profiler_enable_sampling = NULL;
+static MonoProfilerSetSampleMode mono_profiler_set_sample_mode = NULL;
+static MonoProfilerSetSampleHitCallback mono_profiler_set_sample_hit_callback = NULL;
+static MonoProfilerSetJitDoneCallback mono_profiler_set_jit_done_callback = NULL;
+
+
+static void DebugOut(const char *szFormat, ...)
+{
+	va_list vaList;
+	va_start(vaList, szFormat);
+	{
+		char szBuffer[1024];
+		vsprintf(szBuffer, szFormat, vaList);
+		OutputDebugString(szBuffer);
+	}
+	va_end(vaList);
+}
+
+static DWORD HashPointer(const void *ptr)
+{
+	unsigned long long qwValue = (unsigned long long)(ULONG_PTR)ptr;
+	qwValue ^= qwValue >> 33;
+	qwValue *= 0xff51afd7ed558ccdULL;
+	qwValue ^= qwValue >> 33;
+	return (DWORD)qwValue;
+}
+
+static void* FindPointer(const PointerTable *pTable, const void *key)
+{
+	if (pTable) {
+		for (DWORD dwIndex = HashPointer(key) & pTable->dwMask; pTable->entries[dwIndex].key; dwIndex = (dwIndex + 1) & pTable->dwMask) {
+			if (pTable->entries[dwIndex].key == key) {
+				return pTable->entries[dwIndex].value;
+			}
+		}
+	}
 
+	return NULL;
+}
 
-static unsigned int tick(void)
+static void InsertPointer(PointerTable *pTable, const void *key, void *value)
 {
-	LARGE_INTEGER freq;
-	LARGE_INTEGER count;
+	DWORD dwIndex = HashPointer(key) & pTable->dwMask;
 
-	QueryPerformanceFrequency(&freq);
-	QueryPerformanceCounter(&count);
+	while (pTable->entries[dwIndex].key) {
+		dwIndex = (dwIndex + 1) & pTable->dwMask;
+	}
 
-	return (unsigned int)(((double)count.QuadPart / freq.QuadPart) * 1000000);
+	pTable->entries[dwIndex].value = value;
+	MemoryBarrier();
+	pTable->entries[dwIndex].key = key;
+	pTable->dwCount++;
 }
 
-static DWORD HashValue(const char *szString)
+// Caller holds mutexTables
+static void AddPointer(PointerTable *volatile *ppTable, const void *key, void *value)
 {
-	const char *c = szString;
-	DWORD dwHashValue = 0x00000000;
+	PointerTable *pTable = *ppTable;
+
+	if (pTable == NULL || (pTable->dwCount + 1) * 2 > pTable->dwMask + 1) {
+		PointerTable *pNewTable = new PointerTable(pTable ? (pTable->dwMask + 1) * 2 : 1024, pTable);
+
+		if (pTable) {
+			for (DWORD dwIndex = 0; dwIndex <= pTable->dwMask; dwIndex++) {
+				if (pTable->entries[dwIndex].key) {
+					InsertPointer(pNewTable, pTable->entries[dwIndex].key, pTable->entries[dwIndex].value);
+				}
+			}
+		}
 
-	while (*c) {
-		dwHashValue = (dwHashValue << 5) - dwHashValue + (*c == '/' ? '\\' : *c);
-		c++;
+		InterlockedExchangePointer((PVOID volatile *)ppTable, pNewTable);
+		pTable = pNewTable;
 	}
 
-	return dwHashValue;
+	InsertPointer(pTable, key, value);
 }
 
-static void DebugOut(const char *szFormat, ...)
+static void InitLock(PRTL_CRITICAL_SECTION &pMutex)
 {
-	va_list vaList;
-	va_start(vaList, szFormat);
-	{
-		char szBuffer[1024];
-		vsprintf(szBuffer, szFormat, vaList);
-		OutputDebugString(szBuffer);
+	if (pMutex == NULL) {
+		pMutex = (PRTL_CRITICAL_SECTION)malloc(sizeof(RTL_CRITICAL_SECTION));
+		memset(pMutex, 0, sizeof(RTL_CRITICAL_SECTION));
+		InitializeCriticalSection(pMutex);
 	}
-	va_end(vaList);
 }
 
-static DWORD GetMethodStackHash(DWORD dwThreadID)
+static bool MatchPattern(const char *szPattern, const char *szName)
 {
-	if (methodStacks.find(dwThreadID) == methodStacks.end()) {
-		return 0;
+	const char *szStar = NULL;
+	const char *szResume = NULL;
+
+	if (strpbrk(szPattern, "*?") == NULL) {
+		return strncmp(szName, szPattern, strlen(szPattern)) == 0;
 	}
 
-	std::string name = "";
-	std::stack<std::string> methods = methodStacks[dwThreadID];
+	while (*szName) {
+		if (*szPattern == '*') {
+			szStar = szPattern++;
+			szResume = szName;
+		}
+		else if (*szPattern == '?' || *szPattern == *szName) {
+			szPattern++;
+			szName++;
+		}
+		else if (szStar) {
+			szPattern = szStar + 1;
+			szName = ++szResume;
+		}
+		else {
+			return false;
+		}
+	}
 
-	while (methods.empty() == false) {
-		name += methods.top();
-		methods.pop();
+	while (*szPattern == '*') {
+		szPattern++;
 	}
 
-	return HashValue(name.c_str());
+	return *szPattern == 0;
 }
 
-static void gc_event(MonoProfiler *prof, MonoGCEvent event, int generation)
+// Caller holds mutexTables
+static bool IsMethodFiltered(const char *szName)
 {
-	LOG("gc_event\n");
+	for (std::vector<FilterRule>::const_reverse_iterator itRule = filterRules.rbegin(); itRule != filterRules.rend(); itRule++) {
+		if (MatchPattern(itRule->pattern.c_str(), szName)) {
+			return itRule->bInclude == false;
+		}
+	}
+
+	return false;
 }
 
-static void gc_resize(MonoProfiler *prof, gint64 new_size)
+static DWORD HashName(const char *szName)
 {
-	LOG("gc_resize %d\n", new_size);
+	DWORD dwHash = 2166136261u;
+
+	while (*szName) {
+		dwHash = (dwHash ^ (BYTE)*szName++) * 16777619u;
+	}
+
+	return dwHash;
 }
 
-static void sample_method_enter(MonoProfiler *prof, MonoMethod *method)
+// Caller holds mutexTables, generic instantiations and methods seen through several domains end up with the same name
+static const char* InternName(const char *szName)
 {
-	if (bPause) {
-		return;
-	}
+	if ((nameTable.dwCount + 1) * 2 > nameTable.dwMask + 1) {
+		DWORD dwMask = nameTable.names ? nameTable.dwMask * 2 + 1 : 1023;
+		const char **names = (const char **)ArenaAlloc(tableArena, sizeof(const char*) * (dwMask + 1));
+
+		for (DWORD dwIndex = 0; nameTable.names && dwIndex <= nameTable.dwMask; dwIndex++) {
+			if (const char *szOldName = nameTable.names[dwIndex]) {
+				DWORD dwSlot = HashName(szOldName) & dwMask;
+				while (names[dwSlot]) dwSlot = (dwSlot + 1) & dwMask;
+				names[dwSlot] = szOldName;
+			}
+		}
 
-	EnterCriticalSection(mutex);
-	{
-		char name[260];
-		sprintf(name, "%s::%s::%s", method->klass->name_space, method->klass->name, method->name);
+		nameTable.names = names;
+		nameTable.dwMask = dwMask;
+	}
 
-		DWORD dwThreadID = GetCurrentThreadId();
-		DWORD dwParentMethod = GetMethodStackHash(dwThreadID); methodStacks[dwThreadID].push(name);
-		DWORD dwCurrentMethod = GetMethodStackHash(dwThreadID);
+	DWORD dwSlot = HashName(szName) & nameTable.dwMask;
 
-		if (methodSamples[dwThreadID][dwCurrentMethod] == NULL) {
-			methodSamples[dwThreadID][dwCurrentMethod] = new MethodSample(name);
-			methodSamples[dwThreadID][dwCurrentMethod]->pParent = methodSamples[dwThreadID].find(dwParentMethod) != methodSamples[dwThreadID].end() ? methodSamples[dwThreadID][dwParentMethod] : NULL;
+	for (; nameTable.names[dwSlot]; dwSlot = (dwSlot + 1) & nameTable.dwMask) {
+		if (strcmp(nameTable.names[dwSlot], szName) == 0) {
+			return nameTable.names[dwSlot];
 		}
-
-		methodSamples[dwThreadID][dwCurrentMethod]->dwTick = tick();
-		methodSamples[dwThreadID][dwCurrentMethod]->dwCount++;
 	}
-	LeaveCriticalSection(mutex);
+
+	size_t nLength = strlen(szName) + 1;
+	nameTable.names[dwSlot] = (const char *)memcpy(ArenaAlloc(tableArena, nLength, 1), szName, nLength);
+	nameTable.dwCount++;
+
+	return nameTable.names[dwSlot];
 }
 
-static void sample_method_leave(MonoProfiler *prof, MonoMethod *method)
+static MethodInfo* GetMethodInfo(MonoMethod *method)
 {
-	if (bPause) {
-		return;
+	if (MethodInfo *pMethodInfo = (MethodInfo *)FindPointer(methodTable, method)) {
+		return pMethodInfo;
 	}
 
-	EnterCriticalSection(mutex);
+	MethodInfo *pMethodInfo = NULL;
+
+	EnterCriticalSection(mutexTables);
 	{
-		char name[260];
-		sprintf(name, "%s::%s::%s", method->klass->name_space, method->klass->name, method->name);
+		pMethodInfo = (MethodInfo *)FindPointer(methodTable, method);
 
-		DWORD dwThreadID = GetCurrentThreadId();
-		DWORD dwCurrentMethod = GetMethodStackHash(dwThreadID);
+		if (pMethodInfo == NULL && dwMethodCount + 1 < INFO_PAGE_SIZE * INFO_PAGE_COUNT) {
+			char name[260];
 
-		if (methodSamples.find(dwThreadID) != methodSamples.end()) {
-			if (methodStacks[dwThreadID].empty() == false && methodStacks[dwThreadID].top() == name) {
-				methodStacks[dwThreadID].pop();
+			if (mono_method_get_class && mono_method_get_name && mono_class_get_name && mono_class_get_namespace) {
+				MonoClass *klass = mono_method_get_class(method);
+				snprintf(name, sizeof(name), "%s::%s::%s", mono_class_get_namespace(klass), mono_class_get_name(klass), mono_method_get_name(method));
+			}
+			else {
+				snprintf(name, sizeof(name), "%s::%s::%s", method->klass->name_space, method->klass->name, method->name);
 			}
 
-			if (methodSamples[dwThreadID].find(dwCurrentMethod) != methodSamples[dwThreadID].end()) {
-				methodSamples[dwThreadID][dwCurrentMethod]->dwTime += tick() - methodSamples[dwThreadID][dwCurrentMethod]->dwTick;
+			DWORD dwID = dwMethodCount + 1;
+			pMethodInfo = new (ArenaAlloc(tableArena, sizeof(MethodInfo))) MethodInfo(dwID, InternName(name));
+			pMethodInfo->bFiltered = IsMethodFiltered(name);
+
+			if (methodInfos[dwID / INFO_PAGE_SIZE] == NULL) {
+				methodInfos[dwID / INFO_PAGE_SIZE] = (MethodInfo **)ArenaAlloc(tableArena, sizeof(MethodInfo*) * INFO_PAGE_SIZE);
 			}
+
+			methodInfos[dwID / INFO_PAGE_SIZE][dwID % INFO_PAGE_SIZE] = pMethodInfo;
+			AddPointer(&methodTable, method, pMethodInfo);
+
+			MemoryBarrier(); // Publish the info before the new count
+			dwMethodCount = dwID;
 		}
 	}
-	LeaveCriticalSection(mutex);
+	LeaveCriticalSection(mutexTables);
+
+	return pMethodInfo;
 }
 
-static void sample_allocation(MonoProfiler *prof, MonoObject *obj, MonoClass *klass)
+static MethodInfo* FindMethodInfo(DWORD dwMethodID)
 {
-	if (bPause) {
-		return;
+	return methodInfos[dwMethodID / INFO_PAGE_SIZE][dwMethodID % INFO_PAGE_SIZE];
+}
+
+static const char* GetMethodName(DWORD dwMethodID)
+{
+	return FindMethodInfo(dwMethodID)->name;
+}
+
+static ClassInfo* LookupClassInfo(MonoClass *klass)
+{
+	if (ClassInfo *pClassInfo = (ClassInfo *)FindPointer(classTable, klass)) {
+		return pClassInfo;
 	}
 
-	EnterCriticalSection(mutex);
-	{
-		char name[260];
-		sprintf(name, "%s::%s", klass->name_space, klass->name);
+	ClassInfo *pClassInfo = NULL;
 
-		DWORD dwThreadID = GetCurrentThreadId();
-		DWORD dwCurrentMethod = GetMethodStackHash(dwThreadID);
+	EnterCriticalSection(mutexTables);
+	{
+		pClassInfo = (ClassInfo *)FindPointer(classTable, klass);
+
+		if (pClassInfo == NULL && dwClassCount + 1 < INFO_PAGE_SIZE * INFO_PAGE_COUNT) {
+			char name[260];
+			bool bVariableSize;
+			DWORD dwInstanceSize;
+
+			// Newer runtimes changed the MonoClass layout, go through the exported accessors when they exist
+			if (mono_class_get_name && mono_class_get_namespace && mono_class_instance_size && mono_class_get_rank && mono_get_string_class) {
+				snprintf(name, sizeof(name), "%s::%s", mono_class_get_namespace(klass), mono_class_get_name(klass));
+				bVariableSize = mono_class_get_rank(klass) > 0 || klass == mono_get_string_class();
+				dwInstanceSize = mono_class_instance_size(klass);
+			}
+			else {
+				snprintf(name, sizeof(name), "%s::%s", klass->name_space, klass->name);
+				bVariableSize = klass->rank > 0 || klass->byval_arg.type == MONO_TYPE_STRING;
+				dwInstanceSize = klass->instance_size;
+			}
 
-		DWORD dwObjectName = HashValue(name);
-		DWORD dwObjectSize = mono_object_get_size(obj);
+			DWORD dwID = dwClassCount + 1;
+			pClassInfo = new (ArenaAlloc(tableArena, sizeof(ClassInfo))) ClassInfo(dwID, InternName(name), bVariableSize ? 0 : dwInstanceSize, bVariableSize);
 
-		if (methodSamples.find(dwThreadID) != methodSamples.end() && 
-			methodSamples[dwThreadID].find(dwCurrentMethod) != methodSamples[dwThreadID].end()) {
-			if (methodSamples[dwThreadID][dwCurrentMethod]->alloctions[dwObjectName] == NULL) {
-				methodSamples[dwThreadID][dwCurrentMethod]->alloctions[dwObjectName] = new AllocationSample(name);
-				methodSamples[dwThreadID][dwCurrentMethod]->alloctions[dwObjectName]->dwMemorySize = dwObjectSize;
+			if (classInfos[dwID / INFO_PAGE_SIZE] == NULL) {
+				classInfos[dwID / INFO_PAGE_SIZE] = (ClassInfo **)ArenaAlloc(tableArena, sizeof(ClassInfo*) * INFO_PAGE_SIZE);
 			}
 
-			methodSamples[dwThreadID][dwCurrentMethod]->dwMemorySize += dwObjectSize;
-			methodSamples[dwThreadID][dwCurrentMethod]->alloctions[dwObjectName]->dwCount++;
+			classInfos[dwID / INFO_PAGE_SIZE][dwID % INFO_PAGE_SIZE] = pClassInfo;
+			AddPointer(&classTable, klass, pClassInfo);
+
+			MemoryBarrier(); // Publish the info before the new count
+			dwClassCount = dwID;
 		}
 	}
-	LeaveCriticalSection(mutex);
+	LeaveCriticalSection(mutexTables);
+
+	return pClassInfo;
 }
 
-EXPORT_API void Init(const char *szMonoModuleName)
+static const char* GetObjectName(DWORD dwClassID)
 {
-	if (mutex == NULL) {
-		mutex = (PRTL_CRITICAL_SECTION)malloc(sizeof(RTL_CRITICAL_SECTION));
-		memset(mutex, 0, sizeof(RTL_CRITICAL_SECTION));
-		InitializeCriticalSection(mutex);
+	return classInfos[dwClassID / INFO_PAGE_SIZE][dwClassID % INFO_PAGE_SIZE]->name;
+}
+
+// Exponentially distributed byte countdown, sampling bytes as a Poisson process with rate 1/nAllocationInterval
+static long long NextAllocationCountdown(ThreadSamples *pThreadSamples)
+{
+	if (nAllocationInterval <= 0) {
+		return 0;
 	}
 
-	EnterCriticalSection(mutex);
-	{
-		if (HMODULE hMonoLibrary = LoadLibrary(szMonoModuleName)) {
-			mono_profiler_install_enter_leave = (MonoProfilerInstallEnterLeaveFunc)GetProcAddress(hMonoLibrary, "mono_profiler_install_enter_leave");
-			mono_profiler_set_events = (MonoProfilerSetEventsFunc)GetProcAddress(hMonoLibrary, "mono_profiler_set_events");
-			mono_profiler_install_gc = (MonoProfilerInstallGCFunc)GetProcAddress(hMonoLibrary, "mono_profiler_install_gc");
-			mono_profiler_install_allocation = (MonoProfilerInstallAllocation)GetProcAddress(hMonoLibrary, "mono_profiler_install_allocation");
-			mono_object_get_size = (MonoObjectGetSize)GetProcAddress(hMonoLibrary, "mono_object_get_size");
+	DWORD x = pThreadSamples->dwRandom;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pThreadSamples->dwRandom = x;
 
-			mono_profiler_install_gc(gc_event, gc_resize);
-			mono_profiler_install_enter_leave(sample_method_enter, sample_method_leave);
-			mono_profiler_install_allocation(sample_allocation);
-			mono_profiler_set_events((MonoProfileFlags)(MONO_PROFILE_ALLOCATIONS | MONO_PROFILE_GC | MONO_PROFILE_ENTER_LEAVE));
-		}
-		else {
-			LOG("Init mono profiler fail!!!\n");
+	double u = ((x >> 8) + 1) / 16777216.0; // (0, 1]
+	return (long long)(-log(u) * nAllocationInterval) + 1;
+}
+
+// Whoever touches a thread's samples owns them first by moving the epoch from even to odd:
+// the thread itself for the length of a callback, Clear/Dump only for as long as it takes to
+// swap generations. Reading, merging and writing the report happens on retired generations,
+// so a callback never waits for more than one swap of its own thread.
+static void BeginSample(ThreadSamples *pThreadSamples)
+{
+	while (true) {
+		LONG nEpoch = pThreadSamples->nEpoch;
+
+		if ((nEpoch & 1) == 0 && InterlockedCompareExchange(&pThreadSamples->nEpoch, nEpoch + 1, nEpoch) == nEpoch) {
+			break;
 		}
+
+		YieldProcessor();
 	}
-	LeaveCriticalSection(mutex);
+}
 
-	Clear();
+static void EndSample(ThreadSamples *pThreadSamples)
+{
+	InterlockedIncrement(&pThreadSamples->nEpoch);
+}
 
-	bPause = false;
+// A single attempt, for callbacks that must not wait on a claim held by a suspended thread
+static bool TryBeginSample(ThreadSamples *pThreadSamples)
+{
+	LONG nEpoch = pThreadSamples->nEpoch;
+
+	return (nEpoch & 1) == 0 && InterlockedCompareExchange(&pThreadSamples->nEpoch, nEpoch + 1, nEpoch) == nEpoch;
 }
 
-EXPORT_API void Clear(void)
+// Owns every thread's samples at once, caller holds mutex
+static void SuspendSamples(void)
 {
-	bPause = true;
+	for (const auto &itThreadSamples : threadSamples) {
+		BeginSample(itThreadSamples);
+	}
+}
 
-	EnterCriticalSection(mutex);
-	{
-		for (const auto &itThreadMethodSamples : methodSamples) {
-			for (const auto &itMethodSample : itThreadMethodSamples.second) {
-				if (itMethodSample.second) {
-					for (const auto &itAllocationSample : itMethodSample.second->alloctions) {
-						if (itAllocationSample.second) {
-							delete itAllocationSample.second;
-						}
+static void ResumeSamples(void)
+{
+	for (const auto &itThreadSamples : threadSamples) {
+		EndSample(itThreadSamples);
+	}
+}
+
+// Attributes the time since the previous tick to the thread's current stack, runs on the sampler thread
+static void SampleThread(ThreadSamples *pThreadSamples, unsigned long long qwTime)
+{
+	DWORD dwDepth = min(pThreadSamples->methodStack.dwDepth, (DWORD)MAX_STACK_DEPTH);
+	MethodSample *pMethodSample = pThreadSamples->callTree.pRoot;
+
+	for (DWORD dwIndex = 0; dwIndex < dwDepth; dwIndex++) {
+		DWORD dwMethodID = pThreadSamples->methodStack.frames[dwIndex].dwMethodID;
+
+		if (dwMethodID == 0) {
+			break;
+		}
+
+		pMethodSample = GetChild(pThreadSamples->callTree, pMethodSample, dwMethodID);
+		pMethodSample->qwTime += qwTime;
+	}
+
+	if (pMethodSample != pThreadSamples->callTree.pRoot) {
+		pMethodSample->qwSelfTime += qwTime;
+		pMethodSample->dwSamples++;
+	}
+}
+
+static DWORD WINAPI SamplerThread(LPVOID lpParam)
+{
+	DWORD dwInterval = max(1000 / max(nSampleFrequency, 1), 1);
+	unsigned long long qwLastTick = ClockTick();
+
+	timeBeginPeriod(1);
+
+	while (bSamplerExit == FALSE) {
+		Sleep(dwInterval);
+
+		unsigned long long qwTick = ClockTick();
+
+		EnterCriticalSection(mutex);
+		{
+			if (bPause == false) {
+				for (const auto &itThreadSamples : threadSamples) {
+					if (itThreadSamples->bExited == FALSE) {
+						SampleThread(itThreadSamples, qwTick - qwLastTick);
 					}
-					delete itMethodSample.second;
 				}
 			}
 		}
+		LeaveCriticalSection(mutex);
 
-		methodStacks.clear();
-		methodSamples.clear();
+		qwLastTick = qwTick;
 	}
-	LeaveCriticalSection(mutex);
+
+	timeEndPeriod(1);
+
+	return 0;
 }
 
-EXPORT_API void Dump(const char *szDumpFileName, bool bDetails)
+static void StartSampler(void)
 {
-	EnterCriticalSection(mutex);
-	{
-		std::map<DWORD, std::vector<MethodSample*>> methodSampleByTime;
-		std::map<DWORD, std::vector<MethodSample*>> methodSampleByMemory;
-
-		for (const auto &itThreadMethodSamples : methodSamples) {
-			for (const auto &itMethodSample : itThreadMethodSamples.second) {
-				if (itMethodSample.second) {
-					if (itMethodSample.second->dwTime > 0) {
-						methodSampleByTime[itMethodSample.second->dwTime].push_back(itMethodSample.second);
-					}
-					if (itMethodSample.second->dwMemorySize > 0) {
-						methodSampleByMemory[itMethodSample.second->dwMemorySize].push_back(itMethodSample.second);
-					}
-				}
+	if (hSamplerThread == NULL) {
+		bSamplerExit = FALSE;
+		hSamplerThread = CreateThread(NULL, 0, SamplerThread, NULL, 0, NULL);
+	}
+}
+
+static void StopSampler(void)
+{
+	if (hSamplerThread) {
+		InterlockedExchange(&bSamplerExit, TRUE);
+		WaitForSingleObject(hSamplerThread, INFINITE);
+		CloseHandle(hSamplerThread);
+		hSamplerThread = NULL;
+	}
+}
+
+static void PushEvent(ThreadSamples *pThreadSamples, DWORD dwType, DWORD dwID, unsigned long long qwTick, DWORD dwSize, float fWeight)
+{
+	EventRing &eventRing = pThreadSamples->eventRing;
+
+	if (eventRing.records == NULL) {
+		DWORD dwCount = 1;
+		while (dwCount < (DWORD)nPipelineSize) dwCount <<= 1;
+
+		eventRing.records = new EventRecord[dwCount];
+		eventRing.dwMask = dwCount - 1;
+	}
+
+	DWORD dwTail = eventRing.dwTail;
+
+	while (dwTail - eventRing.dwHead > eventRing.dwMask) {
+		if (nPipelinePolicy == PIPELINE_POLICY_DROP) {
+			InterlockedIncrement(&eventRing.nDropped);
+			return;
+		}
+
+		InterlockedIncrement(&eventRing.nSpins);
+		SwitchToThread();
+	}
+
+	EventRecord &record = eventRing.records[dwTail & eventRing.dwMask];
+	record.dwType = dwType;
+	record.dwID = dwID;
+	record.qwTick = qwTick;
+	record.dwSize = dwSize;
+	record.fWeight = fWeight;
+
+	MemoryBarrier(); // Publish the record before the new tail
+	eventRing.dwTail = dwTail + 1;
+}
+
+// Replays a thread's pending records into its samples, caller holds mutex
+static void DrainEvents(ThreadSamples *pThreadSamples)
+{
+	EventRing &eventRing = pThreadSamples->eventRing;
+
+	DWORD dwHead = eventRing.dwHead;
+	DWORD dwTail = eventRing.dwTail;
+
+	MemoryBarrier();
+
+	for (; dwHead != dwTail; dwHead++) {
+		const EventRecord &record = eventRing.records[dwHead & eventRing.dwMask];
+
+		switch (record.dwType) {
+		case EVENT_ENTER:
+			EnterMethod(pThreadSamples->methodStack, &pThreadSamples->callTree, record.dwID, record.qwTick);
+			break;
+		case EVENT_LEAVE:
+			LeaveMethod(pThreadSamples->methodStack, record.dwID, record.qwTick);
+			break;
+		case EVENT_ALLOCATION:
+			RecordAllocation(pThreadSamples->callTree, pThreadSamples->methodStack, record.dwID, record.dwSize, record.fWeight);
+			break;
+		}
+	}
+
+	MemoryBarrier(); // Finish reading the records before handing the slots back
+	eventRing.dwHead = dwHead;
+}
+
+static DWORD WINAPI AggregatorThread(LPVOID lpParam)
+{
+	timeBeginPeriod(1);
+
+	while (bAggregatorExit == FALSE) {
+		Sleep(1);
+
+		EnterCriticalSection(mutex);
+		{
+			for (const auto &itThreadSamples : threadSamples) {
+				DrainEvents(itThreadSamples);
 			}
 		}
+		LeaveCriticalSection(mutex);
+	}
+
+	timeEndPeriod(1);
+
+	return 0;
+}
 
-		TiXmlDocument doc;
-		TiXmlElement *pReportNode = new TiXmlElement("Report");
+static void StartAggregator(void)
+{
+	if (hAggregatorThread == NULL) {
+		bAggregatorExit = FALSE;
+		hAggregatorThread = CreateThread(NULL, 0, AggregatorThread, NULL, 0, NULL);
+	}
+}
+
+static void StopAggregator(void)
+{
+	if (hAggregatorThread) {
+		InterlockedExchange(&bAggregatorExit, TRUE);
+		WaitForSingleObject(hAggregatorThread, INFINITE);
+		CloseHandle(hAggregatorThread);
+		hAggregatorThread = NULL;
+	}
+}
+
+// Samples of exited threads are handed to new threads, so the registry and its arenas stay as large as
+// the most threads alive at once. The recorded data stays where it is and is reported as before.
+static ThreadSamples* GetThreadSamples(void)
+{
+	ThreadSamples *pThreadSamples = (ThreadSamples *)TlsGetValue(dwTlsIndex);
+
+	if (pThreadSamples == NULL) {
+		EnterCriticalSection(mutex);
 		{
-			TiXmlElement *pTimeNode = new TiXmlElement("Time");
-			{
-				for (std::map<DWORD, std::vector<MethodSample*>>::const_reverse_iterator itMethodSamples = methodSampleByTime.rbegin(); itMethodSamples != methodSampleByTime.rend(); itMethodSamples++) {
-					for (const auto &itMethodSample : itMethodSamples->second) {
-						TiXmlElement *pMethodNode = new TiXmlElement("Method");
-						{
-							pMethodNode->SetAttributeString("name", itMethodSample->name);
-							pMethodNode->SetAttributeFloat("total_time", itMethodSample->dwTime / 1000000.0f);
-							pMethodNode->SetAttributeFloat("time", itMethodSample->dwTime / 1000000.0f / itMethodSample->dwCount);
-							pMethodNode->SetAttributeInt("calls", itMethodSample->dwCount);
-
-							if (bDetails) {
-								if (MethodSample *pParent = itMethodSample->pParent) {
-									do {
-										TiXmlElement *pStackNode = new TiXmlElement("CallStack");
-										{
-											pStackNode->SetAttributeString("name", pParent->name);
-											pStackNode->SetAttributeFloat("total_time", pParent->dwTime / 1000000.0f);
-											pStackNode->SetAttributeFloat("time", pParent->dwTime / 1000000.0f / pParent->dwCount);
-										}
-										pMethodNode->LinkEndChild(pStackNode);
-									} while (pParent = pParent->pParent);
-								}
-							}
-						}
-						pTimeNode->LinkEndChild(pMethodNode);
-					}
+			for (const auto &itThreadSamples : threadSamples) {
+				if (itThreadSamples->bExited) {
+					pThreadSamples = itThreadSamples;
+					break;
 				}
 			}
-			pReportNode->LinkEndChild(pTimeNode);
 
-			TiXmlElement *pMemoryNode = new TiXmlElement("Memory");
-			{
-				for (std::map<DWORD, std::vector<MethodSample*>>::const_reverse_iterator itMethodSamples = methodSampleByMemory.rbegin(); itMethodSamples != methodSampleByMemory.rend(); itMethodSamples++) {
-					for (const auto &itMethodSample : itMethodSamples->second) {
-						TiXmlElement *pMethodNode = new TiXmlElement("Method");
-						{
-							pMethodNode->SetAttributeString("name", itMethodSample->name);
-							pMethodNode->SetAttributeInt("total_size", itMethodSample->dwMemorySize);
-							pMethodNode->SetAttributeInt("calls", itMethodSample->dwCount);
-
-							if (bDetails) {
-								for (const auto &itAllocationSample : itMethodSample->alloctions) {
-									TiXmlElement *pObjectNode = new TiXmlElement("Object");
-									{
-										pObjectNode->SetAttributeString("name", itAllocationSample.second->name);
-										pObjectNode->SetAttributeInt("size", itAllocationSample.second->dwMemorySize);
-										pObjectNode->SetAttributeInt("count", itAllocationSample.second->dwCount);
-									}
-									pMethodNode->LinkEndChild(pObjectNode);
-								}
-							}
-						}
-						pMemoryNode->LinkEndChild(pMethodNode);
-					}
-				}
+			if (pThreadSamples) {
+				DrainEvents(pThreadSamples);
+
+				pThreadSamples->dwThreadID = GetCurrentThreadId();
+				pThreadSamples->methodStack.dwDepth = 0;
+				pThreadSamples->methodStack.dwOverflow = 0;
+				pThreadSamples->pTraceChunk = NULL;
+				pThreadSamples->dwTraceDepth = 0;
+				pThreadSamples->bExited = FALSE;
 			}
-			pReportNode->LinkEndChild(pMemoryNode);
+			else {
+				pThreadSamples = new ThreadSamples(GetCurrentThreadId());
+				CreateCallTree(pThreadSamples->callTree);
+				threadSamples.push_back(pThreadSamples);
+			}
+		}
+		LeaveCriticalSection(mutex);
+
+		pThreadSamples->nAllocationCountdown = NextAllocationCountdown(pThreadSamples);
+		TlsSetValue(dwTlsIndex, pThreadSamples);
+	}
+
+	return pThreadSamples;
+}
+
+// Called by the exiting thread under the loader lock, so it takes no locks. The samples are
+// recycled by the next new thread.
+static void ReleaseThreadSamples(void)
+{
+	if (dwTlsIndex == TLS_OUT_OF_INDEXES) {
+		return;
+	}
+
+	if (ThreadSamples *pThreadSamples = (ThreadSamples *)TlsGetValue(dwTlsIndex)) {
+		TlsSetValue(dwTlsIndex, NULL);
+		InterlockedExchange(&pThreadSamples->bExited, TRUE);
+	}
+}
+
+static DWORD BuildEytzinger(JitTable *pTable, DWORD dwIndex, DWORD dwSlot)
+{
+	if (dwSlot <= pTable->ranges.size()) {
+		dwIndex = BuildEytzinger(pTable, dwIndex, dwSlot * 2);
+		pTable->keys[dwSlot] = pTable->ranges[dwIndex].start;
+		pTable->indices[dwSlot] = dwIndex++;
+		dwIndex = BuildEytzinger(pTable, dwIndex, dwSlot * 2 + 1);
+	}
+
+	return dwIndex;
+}
+
+// Caller holds mutexJit
+static void RebuildJitTable(void)
+{
+	if (jitPending.empty()) {
+		return;
+	}
+
+	JitTable *pTable = new JitTable(jitTable);
+
+	if (jitTable) {
+		pTable->ranges = jitTable->ranges;
+	}
+
+	// Newer code at the same address replaces the old range, stable sort keeps the pending ranges last
+	pTable->ranges.insert(pTable->ranges.end(), jitPending.begin(), jitPending.end());
+	std::stable_sort(pTable->ranges.begin(), pTable->ranges.end(), [](const JitRange &a, const JitRange &b) { return a.start < b.start; });
+
+	std::vector<JitRange> ranges;
+	for (const auto &itRange : pTable->ranges) {
+		if (ranges.empty() == false && ranges.back().start == itRange.start) {
+			ranges.back() = itRange;
+		}
+		else {
+			ranges.push_back(itRange);
+		}
+	}
+
+	pTable->ranges.swap(ranges);
+	pTable->keys.resize(pTable->ranges.size() + 1);
+	pTable->indices.resize(pTable->ranges.size() + 1);
+	BuildEytzinger(pTable, 0, 1);
+
+	jitPending.clear();
+	InterlockedExchangePointer((PVOID volatile *)&jitTable, pTable);
+}
+
+// Caller holds mutexJit. Samplers count themselves in before loading jitTable, so with none counted
+// no one can still hold a replaced table.
+static void FreeRetiredJitTables(void)
+{
+	if (jitTable == NULL || nJitReaders != 0) {
+		return;
+	}
+
+	JitTable *pRetired = jitTable->pRetired;
+	jitTable->pRetired = NULL;
+
+	while (pRetired) {
+		JitTable *pNext = pRetired->pRetired;
+		delete pRetired;
+		pRetired = pNext;
+	}
+}
+
+// The table is rebuilt once the pending ranges reach a quarter of it, which keeps the rebuilds
+// linear overall. Hits on code still pending are resolved by the next dump.
+static void AddJitRange(ULONG_PTR start, ULONG_PTR end, DWORD dwMethodID)
+{
+	JitRange range = { start, end, dwMethodID };
+
+	EnterCriticalSection(mutexJit);
+	{
+		jitPending.push_back(range);
+
+		if (jitPending.size() * 4 >= (jitTable ? jitTable->ranges.size() : 0)) {
+			RebuildJitTable();
+		}
+	}
+	LeaveCriticalSection(mutexJit);
+}
+
+static DWORD FindJitMethod(const JitTable *pTable, ULONG_PTR ip)
+{
+	if (pTable == NULL || pTable->ranges.empty()) {
+		return 0;
+	}
+
+	DWORD dwCount = (DWORD)pTable->ranges.size();
+	DWORD dwSlot = 1;
+
+	while (dwSlot <= dwCount) {
+		dwSlot = dwSlot * 2 + (pTable->keys[dwSlot] <= ip);
+	}
+
+	// Drop the trailing right turns and the last left turn to get the first range starting above ip
+	while (dwSlot & 1) {
+		dwSlot >>= 1;
+	}
+	dwSlot >>= 1;
+
+	DWORD dwIndex = dwSlot ? pTable->indices[dwSlot] : dwCount;
+
+	if (dwIndex == 0 || ip >= pTable->ranges[dwIndex - 1].end) {
+		return 0;
+	}
+
+	return pTable->ranges[dwIndex - 1].dwMethodID;
+}
+
+// Caller holds mutexJit
+static void AddUnknownHit(ULONG_PTR ip, DWORD dwCount)
+{
+	for (DWORD dwIndex = (DWORD)HashPointer((const void *)ip) % MAX_UNKNOWN_HITS, dwProbe = 0; dwProbe < MAX_UNKNOWN_HITS; dwIndex = (dwIndex + 1) % MAX_UNKNOWN_HITS, dwProbe++) {
+		if (unknownHits[dwIndex].ip == ip || unknownHits[dwIndex].ip == 0) {
+			unknownHits[dwIndex].ip = ip;
+			unknownHits[dwIndex].dwCount += dwCount;
+			return;
+		}
+	}
+
+	InterlockedExchangeAdd(&nDroppedHits, dwCount);
+}
+
+// Resolves IPs of code JIT compiled before Init through the runtime and adds their ranges to the table.
+// Runs on the dump thread, which is attached to the runtime only for the lookups and never while
+// holding mutexJit. Without attach/detach the hits are dropped rather than calling in unattached.
+static void ResolveUnknownHits(void)
+{
+	MonoDomain *domain = NULL;
+	MonoThread *thread = NULL;
+
+	if (mono_get_root_domain && mono_jit_info_table_find && mono_jit_info_get_method && mono_thread_attach && mono_thread_detach) {
+		domain = mono_get_root_domain();
+		thread = domain ? mono_thread_attach(domain) : NULL;
+		domain = thread ? domain : NULL;
+	}
+
+	EnterCriticalSection(mutexJit);
+	{
+
+		for (DWORD dwIndex = 0; dwIndex < MAX_UNKNOWN_HITS; dwIndex++) {
+			if (unknownHits[dwIndex].ip == 0) {
+				continue;
+			}
+
+			MonoJitInfo *jinfo = domain ? mono_jit_info_table_find(domain, (char *)unknownHits[dwIndex].ip) : NULL;
+			MethodInfo *pMethodInfo = jinfo ? GetMethodInfo(mono_jit_info_get_method(jinfo)) : NULL;
+
+			if (pMethodInfo) {
+				ULONG_PTR start = (ULONG_PTR)mono_jit_info_get_code_start(jinfo);
+				JitRange range = { start, start + mono_jit_info_get_code_size(jinfo), pMethodInfo->dwID };
+
+				jitPending.push_back(range);
+				InterlockedExchangeAdd(&pMethodInfo->nHits, unknownHits[dwIndex].dwCount);
+			}
+			else {
+				InterlockedExchangeAdd(&nDroppedHits, unknownHits[dwIndex].dwCount);
+			}
+		}
+
+		memset(unknownHits, 0, sizeof(unknownHits));
+		RebuildJitTable();
+		FreeRetiredJitTables();
+	}
+	LeaveCriticalSection(mutexJit);
+
+	if (thread) {
+		mono_thread_detach(thread);
+	}
+}
+
+static void jit_end(MonoProfiler *prof, MonoMethod *method, MonoJitInfo *jinfo, int result)
+{
+	if (result != MONO_PROFILE_OK || jinfo == NULL) {
+		return;
+	}
+
+	if (MethodInfo *pMethodInfo = GetMethodInfo(method)) {
+		ULONG_PTR start = (ULONG_PTR)mono_jit_info_get_code_start(jinfo);
+		AddJitRange(start, start + mono_jit_info_get_code_size(jinfo), pMethodInfo->dwID);
+	}
+}
+
+// May run while the sampled thread is suspended holding any lock, including the heap's, so it
+// never allocates or waits. The table is rebuilt by jit_end and the dump thread instead.
+static void sample_statistical(MonoProfiler *prof, guchar *ip, void *context)
+{
+	if (bPause) {
+		return;
+	}
+
+	InterlockedIncrement(&nJitReaders);
+	DWORD dwMethodID = FindJitMethod(jitTable, (ULONG_PTR)ip);
+	InterlockedDecrement(&nJitReaders);
+
+	if (dwMethodID) {
+		InterlockedIncrement(&FindMethodInfo(dwMethodID)->nHits);
+		return;
+	}
+
+	if (TryEnterCriticalSection(mutexJit)) {
+		AddUnknownHit((ULONG_PTR)ip, 1);
+		LeaveCriticalSection(mutexJit);
+	}
+	else {
+		InterlockedIncrement(&nDroppedHits);
+	}
+}
+
+// Returns room for dwSize bytes in the thread's chunk, starting a new chunk when needed, NULL once the file is full
+// or the trace was stopped. Caller owns the samples, so StopTrace cannot unmap the view underneath.
+static BYTE* ReserveTrace(ThreadSamples *pThreadSamples, unsigned long long qwTick, DWORD dwSize)
+{
+	if (bTracing == false || pTraceView == NULL) {
+		return NULL;
+	}
+
+	if (pThreadSamples->nTraceSession != nTraceSession) {
+		pThreadSamples->nTraceSession = nTraceSession;
+		pThreadSamples->pTraceChunk = NULL;
+		pThreadSamples->dwTraceDepth = 0;
+	}
+
+	if (TraceChunkHeader *pChunk = pThreadSamples->pTraceChunk) {
+		if (pChunk->dwUsed + dwSize <= TRACE_CHUNK_SIZE) {
+			return (BYTE *)pChunk + pChunk->dwUsed;
+		}
+	}
+
+	// A continuation chunk starts where the previous one ended, so readers can split time exactly at chunk boundaries
+	unsigned long long qwBaseTick = pThreadSamples->pTraceChunk ? pThreadSamples->qwTraceTick : qwTick;
+	LONGLONG qwOffset = InterlockedExchangeAdd64(&qwTraceOffset, TRACE_CHUNK_SIZE);
+
+	if ((unsigned long long)qwOffset + TRACE_CHUNK_SIZE > qwTraceSize) {
+		pThreadSamples->pTraceChunk = NULL;
+		return NULL;
+	}
+
+	TraceChunkHeader *pChunk = (TraceChunkHeader *)(pTraceView + qwOffset);
+	pChunk->dwMagic = TRACE_CHUNK_MAGIC;
+	pChunk->dwThreadID = pThreadSamples->dwThreadID;
+	pChunk->dwStackDepth = pThreadSamples->dwTraceDepth;
+	pChunk->qwBaseTick = qwBaseTick;
+
+	BYTE *pBuffer = (BYTE *)(pChunk + 1);
+
+	for (DWORD dwIndex = 0; dwIndex < pThreadSamples->dwTraceDepth; dwIndex++) {
+		pBuffer = TraceWriteVarint(pBuffer, pThreadSamples->traceStack[dwIndex]);
+	}
+
+	pChunk->dwUsed = (DWORD)(pBuffer - (BYTE *)pChunk);
+	pThreadSamples->pTraceChunk = pChunk;
+	pThreadSamples->qwTraceTick = qwBaseTick;
+
+	return pBuffer;
+}
+
+// Plain stores into the mapped view, a reader trusts everything below dwUsed
+static void CommitTrace(ThreadSamples *pThreadSamples, BYTE *pEnd)
+{
+	TraceChunkHeader *pChunk = pThreadSamples->pTraceChunk;
+
+	MemoryBarrier();
+	pChunk->dwUsed = (DWORD)(pEnd - (BYTE *)pChunk);
+}
+
+static void TraceEvent(ThreadSamples *pThreadSamples, BYTE tag, unsigned long long qwTick, unsigned long long qwArg0, unsigned long long qwArg1)
+{
+	BYTE *pBuffer = ReserveTrace(pThreadSamples, qwTick, 1 + 3 * TRACE_MAX_VARINT);
+
+	if (pBuffer == NULL) {
+		InterlockedIncrement(&nTraceDropped);
+		return;
+	}
+
+	qwTick = max(qwTick, pThreadSamples->qwTraceTick);
+
+	*pBuffer++ = tag;
+	pBuffer = TraceWriteVarint(pBuffer, qwTick - pThreadSamples->qwTraceTick);
+	pBuffer = TraceWriteVarint(pBuffer, qwArg0);
+
+	if (tag == TRACE_TAG_ALLOCATION || tag == TRACE_TAG_GC) {
+		pBuffer = TraceWriteVarint(pBuffer, qwArg1);
+	}
+
+	pThreadSamples->qwTraceTick = qwTick;
+	CommitTrace(pThreadSamples, pBuffer);
+}
+
+// Whoever swaps in the current session writes the name, readers collect names from all chunks first
+static void TraceName(ThreadSamples *pThreadSamples, BYTE tag, volatile LONG *pSession, DWORD dwID, const char *szName, unsigned long long qwTick)
+{
+	LONG nSession = nTraceSession;
+
+	if (*pSession == nSession || InterlockedExchange(pSession, nSession) == nSession) {
+		return;
+	}
+
+	DWORD dwLength = (DWORD)strlen(szName);
+	BYTE *pBuffer = ReserveTrace(pThreadSamples, qwTick, 1 + 2 * TRACE_MAX_VARINT + dwLength);
+
+	if (pBuffer == NULL) {
+		return;
+	}
+
+	*pBuffer++ = tag;
+	pBuffer = TraceWriteVarint(pBuffer, dwID);
+	pBuffer = TraceWriteVarint(pBuffer, dwLength);
+	memcpy(pBuffer, szName, dwLength);
+	pBuffer += dwLength;
+
+	CommitTrace(pThreadSamples, pBuffer);
+}
+
+static void TraceMethod(ThreadSamples *pThreadSamples, BYTE tag, MethodInfo *pMethodInfo, unsigned long long qwTick)
+{
+	TraceName(pThreadSamples, TRACE_TAG_METHOD_NAME, &pMethodInfo->nTraceSession, pMethodInfo->dwID, pMethodInfo->name, qwTick);
+	TraceEvent(pThreadSamples, tag, qwTick, pMethodInfo->dwID, 0);
+
+	if (tag == TRACE_TAG_ENTER) {
+		if (pThreadSamples->dwTraceDepth < MAX_STACK_DEPTH) {
+			pThreadSamples->traceStack[pThreadSamples->dwTraceDepth++] = pMethodInfo->dwID;
+		}
+	}
+	else {
+		for (DWORD dwIndex = pThreadSamples->dwTraceDepth; dwIndex > 0; dwIndex--) {
+			if (pThreadSamples->traceStack[dwIndex - 1] == pMethodInfo->dwID) {
+				pThreadSamples->dwTraceDepth = dwIndex - 1;
+				break;
+			}
+		}
+	}
+}
+
+// Owns the samples for a trace write, EndSample releases them. StopTrace may have run since the
+// caller checked bTracing, so it is checked again once the samples are owned. bTry drops the event
+// instead of waiting when the samples are busy.
+static bool BeginTrace(ThreadSamples *pThreadSamples, bool bTry)
+{
+	if (bTry == false) {
+		BeginSample(pThreadSamples);
+	}
+	else if (TryBeginSample(pThreadSamples) == false) {
+		InterlockedIncrement(&nTraceDropped);
+		return false;
+	}
+
+	if (bTracing == false) {
+		EndSample(pThreadSamples);
+		return false;
+	}
+
+	return true;
+}
+
+static void gc_event(MonoProfiler *prof, MonoGCEvent event, int generation)
+{
+	LOG("gc_event\n");
+
+	// Runs while the world is stopped, a thread may be suspended holding mutex or this thread's
+	// samples, so threads without samples yet are skipped and a busy claim drops the event
+	ThreadSamples *pThreadSamples = bTracing ? (ThreadSamples *)TlsGetValue(dwTlsIndex) : NULL;
+
+	if (pThreadSamples && BeginTrace(pThreadSamples, true)) {
+		TraceEvent(pThreadSamples, TRACE_TAG_GC, ClockTick(), event, generation);
+		EndSample(pThreadSamples);
+	}
+}
+
+static void gc_resize(MonoProfiler *prof, gint64 new_size)
+{
+	LOG("gc_resize %d\n", new_size);
+}
+
+static void sample_method_enter(MonoProfiler *prof, MonoMethod *method)
+{
+	if (bPause) {
+		return;
+	}
+
+	MethodInfo *pMethodInfo = GetMethodInfo(method);
+
+	if (pMethodInfo == NULL || pMethodInfo->bFiltered) {
+		return;
+	}
+
+	ThreadSamples *pThreadSamples = GetThreadSamples();
+	unsigned long long qwTick = nProfilerMode == PROFILER_MODE_INSTRUMENT || bTracing ? ClockTick() : 0;
+
+	if (bTracing && BeginTrace(pThreadSamples, false)) {
+		TraceMethod(pThreadSamples, TRACE_TAG_ENTER, pMethodInfo, qwTick);
+		EndSample(pThreadSamples);
+	}
+
+	if (bPipeline) {
+		PushEvent(pThreadSamples, EVENT_ENTER, pMethodInfo->dwID, qwTick, 0, 1.0f);
+		return;
+	}
+
+	BeginSample(pThreadSamples);
+	{
+		EnterMethod(pThreadSamples->methodStack, nProfilerMode == PROFILER_MODE_INSTRUMENT ? &pThreadSamples->callTree : NULL, pMethodInfo->dwID, qwTick);
+	}
+	EndSample(pThreadSamples);
+}
+
+static void sample_method_leave(MonoProfiler *prof, MonoMethod *method)
+{
+	if (bPause) {
+		return;
+	}
+
+	MethodInfo *pMethodInfo = GetMethodInfo(method);
+
+	if (pMethodInfo == NULL || pMethodInfo->bFiltered) {
+		return;
+	}
+
+	ThreadSamples *pThreadSamples = GetThreadSamples();
+	unsigned long long qwTick = nProfilerMode == PROFILER_MODE_INSTRUMENT || bTracing ? ClockTick() : 0;
+
+	if (bTracing && BeginTrace(pThreadSamples, false)) {
+		TraceMethod(pThreadSamples, TRACE_TAG_LEAVE, pMethodInfo, qwTick);
+		EndSample(pThreadSamples);
+	}
+
+	if (bPipeline) {
+		PushEvent(pThreadSamples, EVENT_LEAVE, pMethodInfo->dwID, qwTick, 0, 1.0f);
+		return;
+	}
+
+	BeginSample(pThreadSamples);
+	{
+		LeaveMethod(pThreadSamples->methodStack, pMethodInfo->dwID, qwTick);
+	}
+	EndSample(pThreadSamples);
+}
+
+static void sample_allocation(MonoProfiler *prof, MonoObject *obj, MonoClass *klass)
+{
+	if (bPause) {
+		return;
+	}
+
+	ClassInfo *pClassInfo = LookupClassInfo(klass);
+
+	if (pClassInfo == NULL) {
+		return;
+	}
+
+	ThreadSamples *pThreadSamples = GetThreadSamples();
+
+	DWORD dwObjectSize = pClassInfo->bVariableSize ? mono_object_get_size(obj) : pClassInfo->dwInstanceSize;
+	double fWeight = 1.0;
+
+	if (bTracing && BeginTrace(pThreadSamples, false)) {
+		unsigned long long qwTick = ClockTick();
+		TraceName(pThreadSamples, TRACE_TAG_CLASS_NAME, &pClassInfo->nTraceSession, pClassInfo->dwID, pClassInfo->name, qwTick);
+		TraceEvent(pThreadSamples, TRACE_TAG_ALLOCATION, qwTick, pClassInfo->dwID, dwObjectSize);
+		EndSample(pThreadSamples);
+	}
+
+	if (nAllocationInterval > 0) {
+		if ((pThreadSamples->nAllocationCountdown -= dwObjectSize) > 0) {
+			return;
+		}
+
+		// An object of size s is picked with p = 1 - exp(-s / interval), weight by 1/p to keep the estimates unbiased
+		pThreadSamples->nAllocationCountdown = NextAllocationCountdown(pThreadSamples);
+		fWeight = 1.0 / (1.0 - exp(-(double)max(dwObjectSize, 1) / nAllocationInterval));
+	}
+
+	if (bPipeline) {
+		PushEvent(pThreadSamples, EVENT_ALLOCATION, pClassInfo->dwID, 0, dwObjectSize, (float)fWeight);
+		return;
+	}
+
+	BeginSample(pThreadSamples);
+	{
+		RecordAllocation(pThreadSamples->callTree, pThreadSamples->methodStack, pClassInfo->dwID, dwObjectSize, fWeight);
+	}
+	EndSample(pThreadSamples);
+}
+
+static MonoProfilerCallInstrumentationFlags call_instrumentation_filter(MonoProfiler *prof, MonoMethod *method)
+{
+	MethodInfo *pMethodInfo = GetMethodInfo(method);
+
+	if (pMethodInfo == NULL || pMethodInfo->bFiltered) {
+		return MONO_PROFILER_CALL_INSTRUMENTATION_NONE;
+	}
+
+	return (MonoProfilerCallInstrumentationFlags)(MONO_PROFILER_CALL_INSTRUMENTATION_ENTER | MONO_PROFILER_CALL_INSTRUMENTATION_LEAVE | MONO_PROFILER_CALL_INSTRUMENTATION_EXCEPTION_LEAVE);
+}
+
+static void method_enter(MonoProfiler *prof, MonoMethod *method, MonoProfilerCallContext *context)
+{
+	sample_method_enter(prof, method);
+}
+
+static void method_leave(MonoProfiler *prof, MonoMethod *method, MonoProfilerCallContext *context)
+{
+	sample_method_leave(prof, method);
+}
+
+static void method_exception_leave(MonoProfiler *prof, MonoMethod *method, MonoObject *exception)
+{
+	sample_method_leave(prof, method);
+}
+
+static void gc_allocation(MonoProfiler *prof, MonoObject *obj)
+{
+	sample_allocation(prof, obj, mono_object_get_class(obj));
+}
+
+static void gc_event_callback(MonoProfiler *prof, MonoGCEvent event, guint32 generation, mono_bool is_serial)
+{
+	gc_event(prof, event, generation);
+}
+
+static void jit_done(MonoProfiler *prof, MonoMethod *method, MonoJitInfo *jinfo)
+{
+	jit_end(prof, method, jinfo, MONO_PROFILE_OK);
+}
+
+static void sample_hit(MonoProfiler *prof, const guchar *ip, const void *context)
+{
+	sample_statistical(prof, (guchar *)ip, (void *)context);
+}
+
+// Registers with the handle based profiler API when the runtime exports it. Only methods that pass the
+// filters at JIT time get enter/leave probes, so changing filters later does not re-instrument compiled code.
+static bool InstallProfiler(HMODULE hMonoLibrary)
+{
+	mono_profiler_create = (MonoProfilerCreate)GetProcAddress(hMonoLibrary, "mono_profiler_create");
+	mono_profiler_set_call_instrumentation_filter_callback = (MonoProfilerSetCallInstrumentationFilterCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_call_instrumentation_filter_callback");
+	mono_profiler_set_method_enter_callback = (MonoProfilerSetMethodEnterCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_method_enter_callback");
+	mono_profiler_set_method_leave_callback = (MonoProfilerSetMethodLeaveCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_method_leave_callback");
+	mono_profiler_set_method_exception_leave_callback = (MonoProfilerSetMethodExceptionLeaveCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_method_exception_leave_callback");
+	mono_profiler_enable_allocations = (MonoProfilerEnableAllocations)GetProcAddress(hMonoLibrary, "mono_profiler_enable_allocations");
+	mono_profiler_set_gc_allocation_callback = (MonoProfilerSetGCAllocationCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_gc_allocation_callback");
+	mono_profiler_set_gc_event_callback = (MonoProfilerSetGCEventCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_gc_event_callback");
+	mono_profiler_enable_sampling = (MonoProfilerEnableSampling)GetProcAddress(hMonoLibrary, "mono_profiler_enable_sampling");
+	mono_profiler_set_sample_mode = (MonoProfilerSetSampleMode)GetProcAddress(hMonoLibrary, "mono_profiler_set_sample_mode");
+	mono_profiler_set_sample_hit_callback = (MonoProfilerSetSampleHitCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_sample_hit_callback");
+	mono_profiler_set_jit_done_callback = (MonoProfilerSetJitDoneCallback)GetProcAddress(hMonoLibrary, "mono_profiler_set_jit_done_callback");
+
+	if (mono_profiler_create == NULL ||
+		mono_profiler_set_call_instrumentation_filter_callback == NULL ||
+		mono_profiler_set_method_enter_callback == NULL ||
+		mono_profiler_set_method_leave_callback == NULL) {
+		return false;
+	}
+
+	if (hProfiler == NULL) {
+		hProfiler = mono_profiler_create(NULL);
+	}
+
+	if (mono_profiler_set_gc_event_callback) {
+		mono_profiler_set_gc_event_callback(hProfiler, gc_event_callback);
+	}
+
+	if (nProfilerMode == PROFILER_MODE_STATISTICAL) {
+		if (mono_profiler_enable_sampling && mono_profiler_set_sample_hit_callback && mono_profiler_set_jit_done_callback && mono_profiler_enable_sampling(hProfiler)) {
+			if (mono_profiler_set_sample_mode && nSampleFrequency > 0) {
+				mono_profiler_set_sample_mode(hProfiler, MONO_PROFILER_SAMPLE_MODE_PROCESS, nSampleFrequency);
+			}
+
+			mono_profiler_set_jit_done_callback(hProfiler, jit_done);
+			mono_profiler_set_sample_hit_callback(hProfiler, sample_hit);
+		}
+		else {
+			LOG("Mono sampling is unavailable, it must be enabled before the runtime starts\n");
+		}
+
+		return true;
+	}
+
+	mono_profiler_set_call_instrumentation_filter_callback(hProfiler, call_instrumentation_filter);
+	mono_profiler_set_method_enter_callback(hProfiler, method_enter);
+	mono_profiler_set_method_leave_callback(hProfiler, method_leave);
+
+	if (mono_profiler_set_method_exception_leave_callback) {
+		mono_profiler_set_method_exception_leave_callback(hProfiler, method_exception_leave);
+	}
+
+	if (nProfilerMode == PROFILER_MODE_INSTRUMENT && mono_profiler_set_gc_allocation_callback && mono_object_get_class) {
+		if (mono_profiler_enable_allocations && mono_profiler_enable_allocations()) {
+			mono_profiler_set_gc_allocation_callback(hProfiler, gc_allocation);
+		}
+		else {
+			LOG("Mono allocation events are unavailable, they must be enabled before the runtime starts\n");
+		}
+	}
+
+	return true;
+}
+
+BOOL APIENTRY DllMain(HMODULE hModule, DWORD dwReason, LPVOID lpReserved)
+{
+	if (dwReason == DLL_THREAD_DETACH) {
+		ReleaseThreadSamples();
+	}
+
+	return TRUE;
+}
+
+EXPORT_API void Init(const char *szMonoModuleName)
+{
+	InitLock(mutex);
+	InitLock(mutexDump);
+	InitLock(mutexTables);
+	InitLock(mutexJit);
+
+	if (dwTlsIndex == TLS_OUT_OF_INDEXES) {
+		dwTlsIndex = TlsAlloc();
+		ClockInit(CLOCK_SOURCE_AUTO);
+	}
+
+	StopSampler();
+	StopAggregator();
+
+	EnterCriticalSection(mutex);
+	{
+		if (HMODULE hMonoLibrary = LoadLibrary(szMonoModuleName)) {
+			mono_profiler_install_enter_leave = (MonoProfilerInstallEnterLeaveFunc)GetProcAddress(hMonoLibrary, "mono_profiler_install_enter_leave");
+			mono_profiler_set_events = (MonoProfilerSetEventsFunc)GetProcAddress(hMonoLibrary, "mono_profiler_set_events");
+			mono_profiler_install_gc = (MonoProfilerInstallGCFunc)GetProcAddress(hMonoLibrary, "mono_profiler_install_gc");
+			mono_profiler_install_allocation = (MonoProfilerInstallAllocation)GetProcAddress(hMonoLibrary, "mono_profiler_install_allocation");
+			mono_object_get_size = (MonoObjectGetSize)GetProcAddress(hMonoLibrary, "mono_object_get_size");
+			mono_profiler_install_statistical = (MonoProfilerInstallStatistical)GetProcAddress(hMonoLibrary, "mono_profiler_install_statistical");
+			mono_profiler_install_jit_end = (MonoProfilerInstallJitEnd)GetProcAddress(hMonoLibrary, "mono_profiler_install_jit_end");
+			mono_jit_info_get_code_start = (MonoJitInfoGetCodeStart)GetProcAddress(hMonoLibrary, "mono_jit_info_get_code_start");
+			mono_jit_info_get_code_size = (MonoJitInfoGetCodeSize)GetProcAddress(hMonoLibrary, "mono_jit_info_get_code_size");
+			mono_jit_info_get_method = (MonoJitInfoGetMethod)GetProcAddress(hMonoLibrary, "mono_jit_info_get_method");
+			mono_jit_info_table_find = (MonoJitInfoTableFind)GetProcAddress(hMonoLibrary, "mono_jit_info_table_find");
+			mono_get_root_domain = (MonoGetRootDomain)GetProcAddress(hMonoLibrary, "mono_get_root_domain");
+			mono_thread_attach = (MonoThreadAttach)GetProcAddress(hMonoLibrary, "mono_thread_attach");
+			mono_thread_detach = (MonoThreadDetach)GetProcAddress(hMonoLibrary, "mono_thread_detach");
+			mono_method_get_name = (MonoMethodGetName)GetProcAddress(hMonoLibrary, "mono_method_get_name");
+			mono_method_get_class = (MonoMethodGetClass)GetProcAddress(hMonoLibrary, "mono_method_get_class");
+			mono_class_get_name = (MonoClassGetName)GetProcAddress(hMonoLibrary, "mono_class_get_name");
+			mono_class_get_namespace = (MonoClassGetNamespace)GetProcAddress(hMonoLibrary, "mono_class_get_namespace");
+			mono_class_instance_size = (MonoClassInstanceSize)GetProcAddress(hMonoLibrary, "mono_class_instance_size");
+			mono_class_get_rank = (MonoClassGetRank)GetProcAddress(hMonoLibrary, "mono_class_get_rank");
+			mono_get_string_class = (MonoGetStringClass)GetProcAddress(hMonoLibrary, "mono_get_string_class");
+			mono_object_get_class = (MonoObjectGetClass)GetProcAddress(hMonoLibrary, "mono_object_get_class");
+
+			if (InstallProfiler(hMonoLibrary)) {
+				LOG("Using the mono profiler handle API\n");
+			}
+			else if (mono_profiler_install_enter_leave == NULL || mono_profiler_set_events == NULL || mono_profiler_install_gc == NULL || mono_profiler_install_allocation == NULL) {
+				LOG("Init mono profiler fail!!!\n");
+			}
+			else {
+				mono_profiler_install_gc(gc_event, gc_resize);
+				mono_profiler_install_enter_leave(sample_method_enter, sample_method_leave);
+				mono_profiler_install_allocation(sample_allocation);
+
+				// Without these the enter/leave hooks below would run at full cost and record nothing
+				if (nProfilerMode == PROFILER_MODE_STATISTICAL && (mono_profiler_install_statistical == NULL || mono_profiler_install_jit_end == NULL)) {
+					LOG("Statistical mode is not supported by this runtime, falling back to instrumentation!!!\n");
+					nProfilerMode = PROFILER_MODE_INSTRUMENT;
+				}
+
+				if (nProfilerMode == PROFILER_MODE_STATISTICAL) {
+					mono_profiler_install_jit_end(jit_end);
+					mono_profiler_install_statistical(sample_statistical);
+					mono_profiler_set_events((MonoProfileFlags)(MONO_PROFILE_GC | MONO_PROFILE_JIT_COMPILATION | MONO_PROFILE_STATISTICAL));
+				}
+				else if (nProfilerMode == PROFILER_MODE_SAMPLING) {
+					mono_profiler_set_events((MonoProfileFlags)(MONO_PROFILE_GC | MONO_PROFILE_ENTER_LEAVE));
+				}
+				else {
+					mono_profiler_set_events((MonoProfileFlags)(MONO_PROFILE_ALLOCATIONS | MONO_PROFILE_GC | MONO_PROFILE_ENTER_LEAVE));
+				}
+			}
+		}
+		else {
+			LOG("Init mono profiler fail!!!\n");
+		}
+	}
+	LeaveCriticalSection(mutex);
+
+	Clear();
+
+	if (nProfilerMode == PROFILER_MODE_SAMPLING) {
+		StartSampler();
+	}
+
+	bPipeline = nPipelineSize > 0 && nProfilerMode == PROFILER_MODE_INSTRUMENT;
+
+	if (bPipeline) {
+		StartAggregator();
+	}
+
+	bPause = false;
+}
+
+EXPORT_API void SetMode(int nMode, int nFrequency)
+{
+	nProfilerMode = nMode;
+	nSampleFrequency = nFrequency;
+}
+
+EXPORT_API void StopTrace(void)
+{
+	if (bTracing == false) {
+		return;
+	}
+
+	bTracing = false;
+
+	BYTE *pView = NULL;
+	HANDLE hMapping = NULL;
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	unsigned long long qwTraceEnd = 0;
+
+	// Waits out every callback already writing, the ones that follow see bTracing cleared or the view gone.
+	// Only the globals are detached here, the callbacks must not wait for the file to reach disk.
+	EnterCriticalSection(mutex);
+	SuspendSamples();
+	{
+		qwTraceEnd = min((unsigned long long)qwTraceOffset, qwTraceSize);
+
+		for (const auto &itThreadSamples : threadSamples) {
+			itThreadSamples->pTraceChunk = NULL;
+		}
+
+		pView = pTraceView;
+		hMapping = hTraceMapping;
+		hFile = hTraceFile;
+
+		pTraceView = NULL;
+		hTraceMapping = NULL;
+		hTraceFile = INVALID_HANDLE_VALUE;
+	}
+	ResumeSamples();
+	LeaveCriticalSection(mutex);
+
+	FlushViewOfFile(pView, 0);
+	UnmapViewOfFile(pView);
+	CloseHandle(hMapping);
+
+	LARGE_INTEGER size;
+	size.QuadPart = qwTraceEnd;
+	SetFilePointerEx(hFile, size, NULL, FILE_BEGIN);
+	SetEndOfFile(hFile);
+	CloseHandle(hFile);
+
+	if (nTraceDropped) {
+		LOG("Trace file full, %d events dropped\n", nTraceDropped);
+	}
+}
+
+EXPORT_API void StartTrace(const char *szTraceFileName, int nMaxSizeMB)
+{
+	if (mutex == NULL) {
+		LOG("Call Init before StartTrace!!!\n");
+		return;
+	}
+
+	StopTrace();
+
+	qwTraceSize = (unsigned long long)(nMaxSizeMB > 0 ? nMaxSizeMB : 256) * 1024 * 1024;
+
+	hTraceFile = CreateFile(szTraceFileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (hTraceFile == INVALID_HANDLE_VALUE) {
+		LOG("Open trace file fail!!!\n");
+		return;
+	}
+
+	hTraceMapping = CreateFileMapping(hTraceFile, NULL, PAGE_READWRITE, (DWORD)(qwTraceSize >> 32), (DWORD)qwTraceSize, NULL);
+	pTraceView = hTraceMapping ? (BYTE *)MapViewOfFile(hTraceMapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)qwTraceSize) : NULL;
+
+	if (pTraceView == NULL) {
+		LOG("Map trace file fail!!!\n");
+
+		if (hTraceMapping) {
+			CloseHandle(hTraceMapping);
+			hTraceMapping = NULL;
+		}
+
+		CloseHandle(hTraceFile);
+		hTraceFile = INVALID_HANDLE_VALUE;
+		return;
+	}
+
+	TraceFileHeader *pHeader = (TraceFileHeader *)pTraceView;
+	pHeader->dwMagic = TRACE_FILE_MAGIC;
+	pHeader->dwVersion = TRACE_VERSION;
+	pHeader->dwChunkSize = TRACE_CHUNK_SIZE;
+	pHeader->dwReserved = 0;
+	pHeader->qwFrequency = ClockFrequency();
+
+	qwTraceOffset = sizeof(TraceFileHeader);
+	nTraceDropped = 0;
+
+	InterlockedIncrement(&nTraceSession);
+	bTracing = true;
+}
+
+EXPORT_API void SetPipeline(int nRingSize, int nPolicy)
+{
+	nPipelineSize = max(nRingSize, 0);
+	nPipelinePolicy = nPolicy;
+}
+
+EXPORT_API void SetAllocationSampling(int nMeanBytes)
+{
+	nAllocationInterval = max(nMeanBytes, 0);
+}
+
+EXPORT_API void SetDumpLimits(int nTopCount, float fMinShare)
+{
+	reportLimits.dwTopCount = max(nTopCount, 0);
+	reportLimits.fMinShare = max(fMinShare, 0.0f);
+}
+
+// Verdicts of methods already seen are re-evaluated here, so the enter/leave path only reads the cached flag
+static void UpdateFilters(void)
+{
+	for (DWORD dwMethodID = 1; dwMethodID <= dwMethodCount; dwMethodID++) {
+		MethodInfo *pMethodInfo = FindMethodInfo(dwMethodID);
+		pMethodInfo->bFiltered = IsMethodFiltered(pMethodInfo->name);
+	}
+}
+
+EXPORT_API void AddFilter(const char *szPattern, bool bInclude)
+{
+	InitLock(mutexTables);
+
+	EnterCriticalSection(mutexTables);
+	{
+		filterRules.push_back(FilterRule(szPattern, bInclude));
+		UpdateFilters();
+	}
+	LeaveCriticalSection(mutexTables);
+}
+
+EXPORT_API void ClearFilters(void)
+{
+	InitLock(mutexTables);
+
+	EnterCriticalSection(mutexTables);
+	{
+		filterRules.clear();
+		UpdateFilters();
+	}
+	LeaveCriticalSection(mutexTables);
+}
+
+// Retires the live call tree into callTree, an emptied one, and continues in the latter. Open frames
+// are either dropped (Clear) or split: the retired generation keeps their time so far and they are
+// re-entered in the new one with a count of 0.
+// Caller holds mutexDump and mutex, and owns the thread's samples.
+static void SwapCallTree(ThreadSamples *pThreadSamples, CallTree &callTree, bool bReset)
+{
+	if (bReset) {
+		std::swap(pThreadSamples->callTree, callTree);
+		pThreadSamples->methodStack.dwDepth = 0;
+		pThreadSamples->methodStack.dwOverflow = 0;
+		return;
+	}
+
+	// The retiring generation gets the open frames' time up to now, the next one starts counting from here
+	SplitMethods(pThreadSamples->methodStack, ClockTick());
+	std::swap(pThreadSamples->callTree, callTree);
+
+	MethodSample *pMethodSample = pThreadSamples->callTree.pRoot;
+
+	for (DWORD dwIndex = 0; dwIndex < pThreadSamples->methodStack.dwDepth; dwIndex++) {
+		MethodFrame &frame = pThreadSamples->methodStack.frames[dwIndex];
+
+		if (frame.pMethodSample) {
+			pMethodSample = GetChild(pThreadSamples->callTree, pMethodSample, frame.dwMethodID);
+			frame.pMethodSample = pMethodSample;
+		}
+	}
+}
+
+// Swaps the generations of every thread, the retired trees go to callTrees in the order of the returned threads.
+// Caller holds mutexDump.
+static ThreadSamplesList SwapCallTrees(bool bReset, std::vector<CallTree> &callTrees)
+{
+	ThreadSamplesList threads;
+
+	EnterCriticalSection(mutex);
+	{
+		threads = threadSamples;
+
+		for (const auto &itThreadSamples : threads) {
+			callTrees.push_back(CallTree());
+
+			if (spareCallTrees.empty()) {
+				CreateCallTree(callTrees.back());
+			}
+			else {
+				std::swap(callTrees.back(), spareCallTrees.back());
+				spareCallTrees.pop_back();
+			}
+
+			DrainEvents(itThreadSamples);
+
+			BeginSample(itThreadSamples);
+			{
+				SwapCallTree(itThreadSamples, callTrees.back(), bReset);
+			}
+			EndSample(itThreadSamples);
 		}
-		doc.LinkEndChild(pReportNode);
-		doc.SaveFile(szDumpFileName);
 	}
 	LeaveCriticalSection(mutex);
+
+	return threads;
+}
+
+// Takes mutexDump once the dump thread has written every queued report, so the dump trees are free
+static void EnterDumpIdle(void)
+{
+	while (true) {
+		EnterCriticalSection(mutexDump);
+
+		if (dumpRequests.empty()) {
+			break;
+		}
+
+		LeaveCriticalSection(mutexDump);
+		WaitForSingleObject(hDumpDone, INFINITE);
+	}
+}
+
+// Profiling keeps running, the callbacks record into the fresh generation swapped in here
+EXPORT_API void Clear(void)
+{
+	EnterDumpIdle();
+	{
+		std::vector<CallTree> callTrees;
+		ThreadSamplesList threads = SwapCallTrees(true, callTrees);
+
+		for (DWORD dwIndex = 0; dwIndex < threads.size(); dwIndex++) {
+			ClearCallTree(callTrees[dwIndex]);
+			spareCallTrees.push_back(callTrees[dwIndex]);
+
+			if (threads[dwIndex]->dumpCallTree.pRoot) {
+				ClearCallTree(threads[dwIndex]->dumpCallTree);
+			}
+
+			InterlockedExchange(&threads[dwIndex]->eventRing.nDropped, 0);
+			InterlockedExchange(&threads[dwIndex]->eventRing.nSpins, 0);
+		}
+
+		for (DWORD dwMethodID = 1; dwMethodID <= dwMethodCount; dwMethodID++) {
+			FindMethodInfo(dwMethodID)->nHits = 0;
+		}
+
+		EnterCriticalSection(mutexJit);
+		{
+			memset(unknownHits, 0, sizeof(unknownHits));
+			nDroppedHits = 0;
+
+			FreeRetiredJitTables();
+		}
+		LeaveCriticalSection(mutexJit);
+
+		dumpedHits.clear();
+		nDumpedDroppedHits = 0;
+	}
+	LeaveCriticalSection(mutexDump);
+}
+
+static const ReportSource reportSource = { GetMethodName, GetObjectName, ClockSeconds };
+
+// Per thread memory besides the live call tree, whose arena the report reads while the thread records
+static size_t GetThreadExtraSize(const ThreadSamples *pThreadSamples, bool bReserved)
+{
+	size_t nSize = bReserved ? pThreadSamples->dumpCallTree.arena.nReserved : pThreadSamples->dumpCallTree.arena.nUsed;
+	return nSize + sizeof(ThreadSamples) + (pThreadSamples->eventRing.records ? sizeof(EventRecord) * (pThreadSamples->eventRing.dwMask + 1) : 0);
+}
+
+// Runs on the dump thread, nothing here holds a lock the callbacks take
+static void WriteDump(DumpRequest &request)
+{
+	std::vector<DWORD> methodIDByHits;
+	std::vector<LONG> methodHits(dwMethodCount + 1, 0); // Snapshot, indexed by method ID
+
+	std::vector<MethodSample*> methodSamples;
+	std::vector<const MethodSample*> roots;
+	FlatTotals flatTotals;
+
+	const ThreadSamplesList &threads = request.threads;
+
+	for (DWORD dwIndex = 0; dwIndex < threads.size(); dwIndex++) {
+		CallTree &dumpCallTree = threads[dwIndex]->dumpCallTree;
+
+		if (dumpCallTree.pRoot == NULL) {
+			CreateCallTree(dumpCallTree);
+		}
+
+		MergeMethodSample(dumpCallTree, dumpCallTree.pRoot, request.callTrees[dwIndex].pRoot);
+		MethodSample *pRoot = request.bDelta ? request.callTrees[dwIndex].pRoot : dumpCallTree.pRoot;
+		CollectMethodSamples(pRoot, methodSamples);
+		roots.push_back(pRoot);
+	}
+
+	// A pool per report, the idle workers of a lasting one would keep waking up between dumps
+	ThreadPool pool;
+	ThreadPoolCreate(pool, min((int)threads.size(), (int)std::thread::hardware_concurrency()));
+	ComputeFlatTotals(pool, roots, flatTotals);
+	ThreadPoolDestroy(pool);
+
+	if (nProfilerMode == PROFILER_MODE_STATISTICAL) {
+		ResolveUnknownHits();
+	}
+
+	// Delta reports subtract the counters as of the previous dump
+	LONG nDroppedNow = request.bReset ? InterlockedExchange(&nDroppedHits, 0) : nDroppedHits;
+	LONG nDropped = request.bDelta ? nDroppedNow - nDumpedDroppedHits : nDroppedNow;
+	LONG nTotalHits = nDropped;
+
+	nDumpedDroppedHits = request.bReset ? 0 : nDroppedNow;
+	dumpedHits.resize(methodHits.size(), 0);
+
+	for (DWORD dwMethodID = 1; dwMethodID < methodHits.size(); dwMethodID++) {
+		LONG nHits = request.bReset ? InterlockedExchange(&FindMethodInfo(dwMethodID)->nHits, 0) : FindMethodInfo(dwMethodID)->nHits;
+
+		methodHits[dwMethodID] = request.bDelta ? nHits - dumpedHits[dwMethodID] : nHits;
+		dumpedHits[dwMethodID] = request.bReset ? 0 : nHits;
+		nTotalHits += methodHits[dwMethodID];
+	}
+
+	DWORD dwHitMethods = 0;
+
+	for (DWORD dwMethodID = 1; dwMethodID < methodHits.size(); dwMethodID++) {
+		if (methodHits[dwMethodID] > 0) {
+			if (methodHits[dwMethodID] >= request.limits.fMinShare * nTotalHits) {
+				methodIDByHits.push_back(dwMethodID);
+			}
+
+			dwHitMethods++;
+		}
+	}
+
+	RankEntries(methodIDByHits, request.limits.dwTopCount, [&methodHits](DWORD dwMethodID) { return methodHits[dwMethodID]; });
+
+	XmlWriter writer;
+	XmlOpen(writer, request.fileName.c_str());
+
+	XmlBeginElement(writer, "Report");
+	{
+		if (request.bDelta) {
+			XmlAttributeString(writer, "delta", "true");
+		}
+
+		if (request.bDetails) {
+			ReportCallTree(writer, methodSamples, reportSource);
+		}
+
+		ReportTime(writer, methodSamples, request.bDetails, request.limits, reportSource);
+
+		if (nTotalHits > 0) {
+			XmlBeginElement(writer, "Statistical");
+			{
+				XmlAttributeInt(writer, "samples", nTotalHits);
+				XmlAttributeInt(writer, "unknown", nDropped);
+				if (dwHitMethods > methodIDByHits.size()) {
+					XmlAttributeInt(writer, "omitted", dwHitMethods - methodIDByHits.size());
+				}
+
+				for (const auto &itMethodID : methodIDByHits) {
+					XmlBeginElement(writer, "Method");
+					{
+						XmlAttributeString(writer, "name", FindMethodInfo(itMethodID)->name);
+						XmlAttributeInt(writer, "samples", methodHits[itMethodID]);
+						XmlAttributeFloat(writer, "share", (float)methodHits[itMethodID] / nTotalHits);
+					}
+					XmlEndElement(writer);
+				}
+			}
+			XmlEndElement(writer);
+		}
+
+		ReportMemory(writer, methodSamples, request.bDetails, request.limits, reportSource);
+		ReportFlat(writer, flatTotals, request.limits, reportSource);
+
+		if (bPipeline) {
+			XmlBeginElement(writer, "Pipeline");
+			{
+				LONG nTotalDropped = 0;
+				LONG nTotalSpins = 0;
+
+				for (const auto &itThreadSamples : threads) {
+					nTotalDropped += itThreadSamples->eventRing.nDropped;
+					nTotalSpins += itThreadSamples->eventRing.nSpins;
+				}
+
+				XmlAttributeString(writer, "policy", nPipelinePolicy == PIPELINE_POLICY_SPIN ? "spin" : "drop");
+				XmlAttributeInt(writer, "dropped", nTotalDropped);
+				XmlAttributeInt(writer, "spins", nTotalSpins);
+
+				for (const auto &itThreadSamples : threads) {
+					XmlBeginElement(writer, "Thread");
+					{
+						XmlAttributeInt(writer, "id", itThreadSamples->dwThreadID);
+						XmlAttributeInt(writer, "dropped", itThreadSamples->eventRing.nDropped);
+						XmlAttributeInt(writer, "spins", itThreadSamples->eventRing.nSpins);
+					}
+					XmlEndElement(writer);
+				}
+			}
+			XmlEndElement(writer);
+		}
+
+		// The profiler's own memory, apart from the application's allocations above
+		XmlBeginElement(writer, "Profiler");
+		{
+			size_t nTotalUsed = 0;
+			size_t nTotalReserved = 0;
+			size_t nTableUsed = 0;
+			size_t nTableReserved = 0;
+
+			EnterCriticalSection(mutexTables);
+			{
+				nTableUsed = tableArena.nUsed;
+				nTableReserved = tableArena.nReserved;
+			}
+			LeaveCriticalSection(mutexTables);
+
+			// Emptied generations waiting for the next swap
+			EnterCriticalSection(mutexDump);
+			{
+				for (const auto &itCallTree : spareCallTrees) {
+					nTotalUsed += itCallTree.arena.nUsed;
+					nTotalReserved += itCallTree.arena.nReserved;
+				}
+			}
+			LeaveCriticalSection(mutexDump);
+
+			for (const auto &itCallTree : request.callTrees) {
+				nTotalUsed += itCallTree.arena.nUsed;
+				nTotalReserved += itCallTree.arena.nReserved;
+			}
+
+			for (const auto &itThreadSamples : threads) {
+				nTotalUsed += itThreadSamples->callTree.arena.nUsed + GetThreadExtraSize(itThreadSamples, false);
+				nTotalReserved += itThreadSamples->callTree.arena.nReserved + GetThreadExtraSize(itThreadSamples, true);
+			}
+
+			XmlAttributeInt(writer, "used", nTotalUsed + nTableUsed);
+			XmlAttributeInt(writer, "reserved", nTotalReserved + nTableReserved);
+
+			XmlBeginElement(writer, "Tables");
+			{
+				XmlAttributeInt(writer, "methods", dwMethodCount);
+				XmlAttributeInt(writer, "classes", dwClassCount);
+				XmlAttributeInt(writer, "names", nameTable.dwCount);
+				XmlAttributeInt(writer, "used", nTableUsed);
+				XmlAttributeInt(writer, "reserved", nTableReserved);
+			}
+			XmlEndElement(writer);
+
+			for (const auto &itThreadSamples : threads) {
+				XmlBeginElement(writer, "Thread");
+				{
+					XmlAttributeInt(writer, "id", itThreadSamples->dwThreadID);
+					XmlAttributeInt(writer, "used", itThreadSamples->callTree.arena.nUsed + GetThreadExtraSize(itThreadSamples, false));
+					XmlAttributeInt(writer, "reserved", itThreadSamples->callTree.arena.nReserved + GetThreadExtraSize(itThreadSamples, true));
+				}
+				XmlEndElement(writer);
+			}
+		}
+		XmlEndElement(writer);
+	}
+	XmlEndElement(writer);
+
+	XmlClose(writer);
+
+	for (auto &itCallTree : request.callTrees) {
+		ClearCallTree(itCallTree);
+	}
+
+	if (request.bReset) {
+		for (const auto &itThreadSamples : threads) {
+			ClearCallTree(itThreadSamples->dumpCallTree);
+		}
+	}
+}
+
+static DWORD WINAPI DumpThread(LPVOID lpParam)
+{
+	while (true) {
+		DumpRequest *pRequest = NULL;
+
+		EnterCriticalSection(mutexDump);
+		{
+			if (dumpRequests.empty() == false) {
+				pRequest = dumpRequests.front();
+			}
+		}
+		LeaveCriticalSection(mutexDump);
+
+		if (pRequest == NULL) {
+			WaitForSingleObject(hDumpQueued, INFINITE);
+			continue;
+		}
+
+		ResetEvent(hDumpDone);
+		WriteDump(*pRequest);
+
+		EnterCriticalSection(mutexDump);
+		{
+			spareCallTrees.insert(spareCallTrees.end(), pRequest->callTrees.begin(), pRequest->callTrees.end());
+			dumpRequests.erase(dumpRequests.begin());
+		}
+		LeaveCriticalSection(mutexDump);
+
+		InterlockedExchange(&nDumpsDone, pRequest->nDumpID);
+		SetEvent(hDumpDone);
+		delete pRequest;
+	}
+
+	return 0;
+}
+
+// Swaps generations and queues the report, returns its dump ID
+static LONG QueueDump(const char *szDumpFileName, bool bDetails, bool bDelta, bool bReset)
+{
+	LONG nDumpID = 0;
+
+	EnterCriticalSection(mutexDump);
+	{
+		nDumpID = InterlockedIncrement(&nDumpCount);
+
+		DumpRequest *pRequest = new DumpRequest(nDumpID, szDumpFileName, bDetails, bDelta, bReset);
+		pRequest->limits = reportLimits;
+		pRequest->threads = SwapCallTrees(false, pRequest->callTrees);
+
+		dumpRequests.push_back(pRequest);
+
+		if (hDumpThread == NULL) {
+			hDumpQueued = CreateEvent(NULL, FALSE, FALSE, NULL);
+			hDumpDone = CreateEvent(NULL, TRUE, TRUE, NULL);
+			hDumpThread = CreateThread(NULL, 0, DumpThread, NULL, 0, NULL);
+		}
+
+		SetEvent(hDumpQueued);
+	}
+	LeaveCriticalSection(mutexDump);
+
+	return nDumpID;
+}
+
+EXPORT_API int DumpAsync(const char *szDumpFileName, bool bDetails)
+{
+	if (mutex == NULL) {
+		LOG("Call Init before DumpAsync!!!\n");
+		return 0;
+	}
+
+	return QueueDump(szDumpFileName, bDetails, false, false);
+}
+
+EXPORT_API bool IsDumpDone(int nDumpID)
+{
+	return nDumpsDone >= nDumpID;
+}
+
+// hDumpDone stays set once the queue is empty, so a wait can only be late by one report, never lost
+static void WaitForDump(LONG nDumpID)
+{
+	while (IsDumpDone(nDumpID) == false) {
+		WaitForSingleObject(hDumpDone, INFINITE);
+	}
+}
+
+EXPORT_API void Dump(const char *szDumpFileName, bool bDetails)
+{
+	WaitForDump(DumpAsync(szDumpFileName, bDetails));
+}
+
+// Each generation holds exactly the nodes touched since the previous swap, so the delta is the
+// retired generations themselves and writing it costs time proportional to the activity since then
+EXPORT_API void DumpDelta(const char *szDumpFileName, bool bDetails)
+{
+	if (mutex == NULL) {
+		LOG("Call Init before DumpDelta!!!\n");
+		return;
+	}
+
+	WaitForDump(QueueDump(szDumpFileName, bDetails, true, false));
+}
+
+// Deletes the oldest files beyond nAutoDumpKeep, but only once the dump thread has finished writing
+// them. Dumps complete in order, so an unfinished oldest file leaves the rest for the next call.
+static void PruneAutoDumps(std::vector<std::pair<std::string, LONG>> &autoDumps)
+{
+	while (nAutoDumpKeep > 0 && autoDumps.size() > (size_t)nAutoDumpKeep && IsDumpDone(autoDumps.front().second)) {
+		DeleteFile(autoDumps.front().first.c_str());
+		autoDumps.erase(autoDumps.begin());
+	}
+}
+
+// Writes <prefix>_YYYYMMDD_HHMMSS.xml every interval, each covering the interval alone, and deletes
+// the oldest files beyond nAutoDumpKeep. The call trees are reused, so memory does not grow with time.
+static DWORD WINAPI AutoDumpThread(LPVOID lpParam)
+{
+	std::vector<std::pair<std::string, LONG>> autoDumps; // [file name, dump ID], oldest first
+	unsigned long long qwLastTick = ClockTick();
+
+	while (bAutoDumpExit == FALSE) {
+		Sleep(100);
+		PruneAutoDumps(autoDumps);
+
+		if (ClockSeconds(ClockTick() - qwLastTick) < nAutoDumpInterval) {
+			continue;
+		}
+
+		qwLastTick = ClockTick();
+
+		SYSTEMTIME time;
+		GetLocalTime(&time);
+
+		char szTime[32];
+		sprintf(szTime, "_%04d%02d%02d_%02d%02d%02d.xml", time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond);
+
+		std::string fileName = autoDumpPrefix + szTime;
+		autoDumps.push_back(std::make_pair(fileName, QueueDump(fileName.c_str(), bAutoDumpDetails, false, true)));
+	}
+
+	if (autoDumps.empty() == false) {
+		WaitForDump(autoDumps.back().second);
+		PruneAutoDumps(autoDumps);
+	}
+
+	return 0;
+}
+
+EXPORT_API void StopAutoDump(void)
+{
+	if (hAutoDumpThread) {
+		InterlockedExchange(&bAutoDumpExit, TRUE);
+		WaitForSingleObject(hAutoDumpThread, INFINITE);
+		CloseHandle(hAutoDumpThread);
+		hAutoDumpThread = NULL;
+	}
+}
+
+EXPORT_API void StartAutoDump(const char *szFilePrefix, int nIntervalSeconds, int nKeepCount, bool bDetails)
+{
+	if (mutex == NULL) {
+		LOG("Call Init before StartAutoDump!!!\n");
+		return;
+	}
+
+	StopAutoDump();
+
+	autoDumpPrefix = szFilePrefix;
+	nAutoDumpInterval = max(nIntervalSeconds, 1);
+	nAutoDumpKeep = max(nKeepCount, 0);
+	bAutoDumpDetails = bDetails;
+
+	bAutoDumpExit = FALSE;
+	hAutoDumpThread = CreateThread(NULL, 0, AutoDumpThread, NULL, 0, NULL);
 }
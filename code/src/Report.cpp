@@ -0,0 +1,324 @@
+#include "Report.h"
+
+
+static void WriteTime(XmlWriter &writer, const MethodSample *pMethodSample, const ReportSource &source)
+{
+	XmlAttributeString(writer, "name", source.GetMethodName(pMethodSample->dwMethodID));
+	XmlAttributeFloat(writer, "total_time", (float)source.GetSeconds(pMethodSample->qwTime));
+	XmlAttributeFloat(writer, "self_time", (float)source.GetSeconds(pMethodSample->qwSelfTime));
+	if (pMethodSample->dwCount) {
+		XmlAttributeFloat(writer, "time", (float)source.GetSeconds(pMethodSample->qwTime) / pMethodSample->dwCount);
+	}
+}
+
+void ReportCallTree(XmlWriter &writer, const std::vector<MethodSample*> &methodSamples, const ReportSource &source)
+{
+	std::vector<std::pair<const MethodSample*, DWORD>> path; // Ancestors of the current node with their IDs
+
+	XmlBeginElement(writer, "CallTree");
+	{
+		for (DWORD dwIndex = 0; dwIndex < methodSamples.size(); dwIndex++) {
+			const MethodSample *pMethodSample = methodSamples[dwIndex];
+
+			while (path.empty() == false && path.back().first != pMethodSample->pParent) {
+				path.pop_back();
+			}
+
+			XmlBeginElement(writer, "Node");
+			{
+				XmlAttributeInt(writer, "id", dwIndex + 1);
+				XmlAttributeInt(writer, "parent", path.empty() ? 0 : path.back().second);
+				WriteTime(writer, pMethodSample, source);
+				XmlAttributeInt(writer, "calls", pMethodSample->dwCount);
+				if (pMethodSample->dwSamples) {
+					XmlAttributeInt(writer, "samples", pMethodSample->dwSamples);
+				}
+			}
+			XmlEndElement(writer);
+
+			path.push_back(std::make_pair(pMethodSample, dwIndex + 1));
+		}
+	}
+	XmlEndElement(writer);
+}
+
+void ReportTime(XmlWriter &writer, const std::vector<MethodSample*> &methodSamples, bool bDetails, const ReportLimits &limits, const ReportSource &source)
+{
+	std::vector<DWORD> methodSampleByTime; // Indices into methodSamples, node ID - 1
+	unsigned long long qwTotalTime = 0;
+	DWORD dwEntries = 0;
+
+	for (const auto &itMethodSample : methodSamples) {
+		qwTotalTime += itMethodSample->qwSelfTime;
+	}
+
+	for (DWORD dwIndex = 0; dwIndex < methodSamples.size(); dwIndex++) {
+		if (methodSamples[dwIndex]->qwTime > 0) {
+			if (methodSamples[dwIndex]->qwSelfTime >= limits.fMinShare * qwTotalTime) {
+				methodSampleByTime.push_back(dwIndex);
+			}
+
+			dwEntries++;
+		}
+	}
+
+	RankEntries(methodSampleByTime, limits.dwTopCount, [&methodSamples](DWORD dwIndex) { return methodSamples[dwIndex]->qwSelfTime; });
+
+	XmlBeginElement(writer, "Time");
+	{
+		if (dwEntries > methodSampleByTime.size()) {
+			XmlAttributeInt(writer, "omitted", dwEntries - methodSampleByTime.size());
+		}
+
+		for (const auto &itIndex : methodSampleByTime) {
+			const MethodSample *pMethodSample = methodSamples[itIndex];
+
+			XmlBeginElement(writer, "Method");
+			{
+				WriteTime(writer, pMethodSample, source);
+				XmlAttributeInt(writer, "calls", pMethodSample->dwCount);
+				if (pMethodSample->dwSamples) {
+					XmlAttributeInt(writer, "samples", pMethodSample->dwSamples);
+				}
+				if (bDetails) {
+					XmlAttributeInt(writer, "node", itIndex + 1);
+				}
+			}
+			XmlEndElement(writer);
+		}
+	}
+	XmlEndElement(writer);
+}
+
+void ReportMemory(XmlWriter &writer, const std::vector<MethodSample*> &methodSamples, bool bDetails, const ReportLimits &limits, const ReportSource &source)
+{
+	std::vector<DWORD> methodSampleByMemory; // Indices into methodSamples, node ID - 1
+	double fTotalMemorySize = 0.0;
+	DWORD dwEntries = 0;
+
+	for (const auto &itMethodSample : methodSamples) {
+		fTotalMemorySize += itMethodSample->fMemorySize;
+	}
+
+	for (DWORD dwIndex = 0; dwIndex < methodSamples.size(); dwIndex++) {
+		if (methodSamples[dwIndex]->fMemorySize > 0.0) {
+			if (methodSamples[dwIndex]->fMemorySize >= limits.fMinShare * fTotalMemorySize) {
+				methodSampleByMemory.push_back(dwIndex);
+			}
+
+			dwEntries++;
+		}
+	}
+
+	RankEntries(methodSampleByMemory, limits.dwTopCount, [&methodSamples](DWORD dwIndex) { return methodSamples[dwIndex]->fMemorySize; });
+
+	XmlBeginElement(writer, "Memory");
+	{
+		if (dwEntries > methodSampleByMemory.size()) {
+			XmlAttributeInt(writer, "omitted", dwEntries - methodSampleByMemory.size());
+		}
+
+		for (const auto &itIndex : methodSampleByMemory) {
+			const MethodSample *pMethodSample = methodSamples[itIndex];
+
+			XmlBeginElement(writer, "Method");
+			{
+				XmlAttributeString(writer, "name", source.GetMethodName(pMethodSample->dwMethodID));
+				XmlAttributeInt(writer, "total_size", (long long)(pMethodSample->fMemorySize + 0.5));
+				XmlAttributeInt(writer, "calls", pMethodSample->dwCount);
+
+				if (bDetails) {
+					XmlAttributeInt(writer, "node", itIndex + 1);
+
+					for (const AllocationSample *pAllocationSample = pMethodSample->pAllocations; pAllocationSample; pAllocationSample = pAllocationSample->pNext) {
+						XmlBeginElement(writer, "Object");
+						{
+							XmlAttributeString(writer, "name", source.GetObjectName(pAllocationSample->dwClassID));
+							XmlAttributeInt(writer, "size", pAllocationSample->dwObjectSize);
+							XmlAttributeInt(writer, "count", (long long)(pAllocationSample->fCount + 0.5));
+							XmlAttributeInt(writer, "total_size", (long long)(pAllocationSample->fMemorySize + 0.5));
+						}
+						XmlEndElement(writer);
+					}
+				}
+			}
+			XmlEndElement(writer);
+		}
+	}
+	XmlEndElement(writer);
+}
+
+// dwActive counts the frames of each method on the path to pMethodSample
+static void CollectFlatTotals(const MethodSample *pMethodSample, FlatTotals &totals, std::vector<DWORD> &dwActive)
+{
+	DWORD dwCount;
+	MethodSample* const* children = GetChildren(pMethodSample, dwCount);
+
+	for (DWORD dwIndex = 0; dwIndex < dwCount; dwIndex++) {
+		const MethodSample *pChild = children[dwIndex];
+
+		if (pChild == NULL) {
+			continue;
+		}
+
+		if (pChild->dwMethodID >= totals.methods.size()) {
+			totals.methods.resize(pChild->dwMethodID + 1);
+			dwActive.resize(pChild->dwMethodID + 1, 0);
+		}
+
+		MethodTotal &methodTotal = totals.methods[pChild->dwMethodID];
+		methodTotal.dwCount += pChild->dwCount;
+		methodTotal.dwSamples += pChild->dwSamples;
+		methodTotal.qwSelfTime += pChild->qwSelfTime;
+		methodTotal.fMemorySize += pChild->fMemorySize;
+
+		if (dwActive[pChild->dwMethodID] == 0) {
+			methodTotal.qwTime += pChild->qwTime;
+		}
+
+		for (const AllocationSample *pAllocationSample = pChild->pAllocations; pAllocationSample; pAllocationSample = pAllocationSample->pNext) {
+			if (pAllocationSample->dwClassID >= totals.classes.size()) {
+				totals.classes.resize(pAllocationSample->dwClassID + 1);
+			}
+
+			totals.classes[pAllocationSample->dwClassID].fCount += pAllocationSample->fCount;
+			totals.classes[pAllocationSample->dwClassID].fMemorySize += pAllocationSample->fMemorySize;
+		}
+
+		dwActive[pChild->dwMethodID]++;
+		CollectFlatTotals(pChild, totals, dwActive);
+		dwActive[pChild->dwMethodID]--;
+	}
+}
+
+static void MergeFlatTotals(FlatTotals &totals, const FlatTotals &other)
+{
+	totals.methods.resize((std::max)(totals.methods.size(), other.methods.size()));
+	totals.classes.resize((std::max)(totals.classes.size(), other.classes.size()));
+
+	for (size_t nIndex = 0; nIndex < other.methods.size(); nIndex++) {
+		totals.methods[nIndex].dwCount += other.methods[nIndex].dwCount;
+		totals.methods[nIndex].dwSamples += other.methods[nIndex].dwSamples;
+		totals.methods[nIndex].qwTime += other.methods[nIndex].qwTime;
+		totals.methods[nIndex].qwSelfTime += other.methods[nIndex].qwSelfTime;
+		totals.methods[nIndex].fMemorySize += other.methods[nIndex].fMemorySize;
+	}
+
+	for (size_t nIndex = 0; nIndex < other.classes.size(); nIndex++) {
+		totals.classes[nIndex].fCount += other.classes[nIndex].fCount;
+		totals.classes[nIndex].fMemorySize += other.classes[nIndex].fMemorySize;
+	}
+}
+
+void ComputeFlatTotals(ThreadPool &pool, const std::vector<const MethodSample*> &roots, FlatTotals &totals)
+{
+	std::vector<FlatTotals> tables(roots.size());
+
+	for (size_t nIndex = 0; nIndex < roots.size(); nIndex++) {
+		ThreadPoolSubmit(pool, [&, nIndex]() {
+			std::vector<DWORD> dwActive;
+			CollectFlatTotals(roots[nIndex], tables[nIndex], dwActive);
+		});
+	}
+
+	ThreadPoolWait(pool);
+
+	// Pairwise merge, every round halves the tables
+	for (size_t nStride = 1; nStride < tables.size(); nStride *= 2) {
+		for (size_t nIndex = 0; nIndex + nStride < tables.size(); nIndex += nStride * 2) {
+			ThreadPoolSubmit(pool, [&, nIndex, nStride]() { MergeFlatTotals(tables[nIndex], tables[nIndex + nStride]); });
+		}
+
+		ThreadPoolWait(pool);
+	}
+
+	if (tables.empty() == false) {
+		std::swap(totals, tables[0]);
+	}
+}
+
+void ReportFlat(XmlWriter &writer, const FlatTotals &totals, const ReportLimits &limits, const ReportSource &source)
+{
+	std::vector<DWORD> methodIDBySelfTime;
+	std::vector<DWORD> classIDByMemory;
+	unsigned long long qwTotalTime = 0;
+	double fTotalMemorySize = 0.0;
+	DWORD dwMethods = 0;
+	DWORD dwClasses = 0;
+
+	for (const auto &itMethodTotal : totals.methods) {
+		qwTotalTime += itMethodTotal.qwSelfTime;
+	}
+
+	for (const auto &itClassTotal : totals.classes) {
+		fTotalMemorySize += itClassTotal.fMemorySize;
+	}
+
+	for (DWORD dwMethodID = 1; dwMethodID < totals.methods.size(); dwMethodID++) {
+		if (totals.methods[dwMethodID].dwCount > 0 || totals.methods[dwMethodID].qwTime > 0) {
+			if (totals.methods[dwMethodID].qwSelfTime >= limits.fMinShare * qwTotalTime) {
+				methodIDBySelfTime.push_back(dwMethodID);
+			}
+
+			dwMethods++;
+		}
+	}
+
+	for (DWORD dwClassID = 1; dwClassID < totals.classes.size(); dwClassID++) {
+		if (totals.classes[dwClassID].fMemorySize > 0.0) {
+			if (totals.classes[dwClassID].fMemorySize >= limits.fMinShare * fTotalMemorySize) {
+				classIDByMemory.push_back(dwClassID);
+			}
+
+			dwClasses++;
+		}
+	}
+
+	RankEntries(methodIDBySelfTime, limits.dwTopCount, [&totals](DWORD dwMethodID) { return totals.methods[dwMethodID].qwSelfTime; });
+	RankEntries(classIDByMemory, limits.dwTopCount, [&totals](DWORD dwClassID) { return totals.classes[dwClassID].fMemorySize; });
+
+	XmlBeginElement(writer, "Methods");
+	{
+		if (dwMethods > methodIDBySelfTime.size()) {
+			XmlAttributeInt(writer, "omitted", dwMethods - methodIDBySelfTime.size());
+		}
+
+		for (const auto &itMethodID : methodIDBySelfTime) {
+			const MethodTotal &methodTotal = totals.methods[itMethodID];
+
+			XmlBeginElement(writer, "Method");
+			{
+				XmlAttributeString(writer, "name", source.GetMethodName(itMethodID));
+				XmlAttributeFloat(writer, "total_time", (float)source.GetSeconds(methodTotal.qwTime));
+				XmlAttributeFloat(writer, "self_time", (float)source.GetSeconds(methodTotal.qwSelfTime));
+				XmlAttributeInt(writer, "calls", methodTotal.dwCount);
+				if (methodTotal.dwSamples) {
+					XmlAttributeInt(writer, "samples", methodTotal.dwSamples);
+				}
+				if (methodTotal.fMemorySize > 0.0) {
+					XmlAttributeInt(writer, "total_size", (long long)(methodTotal.fMemorySize + 0.5));
+				}
+			}
+			XmlEndElement(writer);
+		}
+	}
+	XmlEndElement(writer);
+
+	XmlBeginElement(writer, "Classes");
+	{
+		if (dwClasses > classIDByMemory.size()) {
+			XmlAttributeInt(writer, "omitted", dwClasses - classIDByMemory.size());
+		}
+
+		for (const auto &itClassID : classIDByMemory) {
+			XmlBeginElement(writer, "Class");
+			{
+				XmlAttributeString(writer, "name", source.GetObjectName(itClassID));
+				XmlAttributeInt(writer, "count", (long long)(totals.classes[itClassID].fCount + 0.5));
+				XmlAttributeInt(writer, "total_size", (long long)(totals.classes[itClassID].fMemorySize + 0.5));
+			}
+			XmlEndElement(writer);
+		}
+	}
+	XmlEndElement(writer);
+}
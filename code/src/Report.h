@@ -0,0 +1,98 @@
+#ifndef _REPORT_H_
+#define _REPORT_H_
+
+#include <algorithm>
+#include "CallTree.h"
+#include "ThreadPool.h"
+#include "XmlWriter.h"
+
+
+typedef struct ReportSource {
+	const char* (*GetMethodName)(DWORD dwMethodID);
+	const char* (*GetObjectName)(DWORD dwClassID);
+	double (*GetSeconds)(unsigned long long qwTicks);
+} ReportSource;
+
+typedef struct ReportLimits {
+	ReportLimits(void)
+		: dwTopCount(0)
+		, fMinShare(0.0)
+	{
+
+	}
+
+	DWORD dwTopCount; // Entries per section, 0 keeps all
+	double fMinShare; // Entries below this fraction of the section total are left out
+} ReportLimits;
+
+typedef struct MethodTotal {
+	MethodTotal(void)
+		: dwCount(0)
+		, dwSamples(0)
+		, qwTime(0)
+		, qwSelfTime(0)
+		, fMemorySize(0.0)
+	{
+
+	}
+
+	DWORD dwCount;
+	DWORD dwSamples;
+	unsigned long long qwTime; // Only the outermost call of a recursion counts, so nested calls are not added twice
+	unsigned long long qwSelfTime;
+	double fMemorySize;
+} MethodTotal;
+
+typedef struct ClassTotal {
+	ClassTotal(void)
+		: fCount(0.0)
+		, fMemorySize(0.0)
+	{
+
+	}
+
+	double fCount;
+	double fMemorySize;
+} ClassTotal;
+
+// Per method and per class totals over any number of call trees, indexed by ID
+typedef struct FlatTotals {
+	std::vector<MethodTotal> methods;
+	std::vector<ClassTotal> classes;
+} FlatTotals;
+
+
+// Orders entries by descending key, ties by ascending entry, and keeps the first dwTopCount (0 keeps all).
+// Only the kept entries are fully sorted.
+template<typename Key>
+void RankEntries(std::vector<DWORD> &entries, DWORD dwTopCount, Key key)
+{
+	auto compare = [&key](DWORD a, DWORD b) { return key(a) > key(b) || (key(a) == key(b) && a < b); };
+
+	if (dwTopCount > 0 && dwTopCount < entries.size()) {
+		std::nth_element(entries.begin(), entries.begin() + dwTopCount, entries.end(), compare);
+		entries.resize(dwTopCount);
+	}
+
+	std::sort(entries.begin(), entries.end(), compare);
+}
+
+
+// Write every node of the trees once, in the pre-order CollectMethodSamples produces. Node IDs are
+// 1-based positions in methodSamples, parent 0 is a thread root. Detailed Time and Memory entries
+// refer to these IDs instead of repeating their call stacks.
+void ReportCallTree(XmlWriter &writer, const std::vector<MethodSample*> &methodSamples, const ReportSource &source);
+
+// Write the Time (ranked by self time) and Memory (ranked by allocated bytes) sections of a report
+void ReportTime(XmlWriter &writer, const std::vector<MethodSample*> &methodSamples, bool bDetails, const ReportLimits &limits, const ReportSource &source);
+void ReportMemory(XmlWriter &writer, const std::vector<MethodSample*> &methodSamples, bool bDetails, const ReportLimits &limits, const ReportSource &source);
+
+// Sums the trees (one per thread) into flat totals. Every tree gets its own table on a pool worker,
+// then the tables are added pairwise in parallel rounds.
+void ComputeFlatTotals(ThreadPool &pool, const std::vector<const MethodSample*> &roots, FlatTotals &totals);
+
+// Write the Methods (ranked by self time) and Classes (ranked by allocated bytes) sections, one entry
+// per method or class across all threads and call stacks
+void ReportFlat(XmlWriter &writer, const FlatTotals &totals, const ReportLimits &limits, const ReportSource &source);
+
+#endif
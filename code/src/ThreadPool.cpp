@@ -0,0 +1,127 @@
+#include <algorithm>
+#include "ThreadPool.h"
+
+
+static thread_local int nWorkerIndex = -1;
+static std::atomic<unsigned int> dwNextQueue(0);
+
+static bool PopTask(ThreadPool &pool, int nIndex, Task &task)
+{
+	WorkQueue *pQueue = pool.queues[nIndex];
+	std::lock_guard<std::mutex> lock(pQueue->mutex);
+
+	if (pQueue->tasks.empty()) {
+		return false;
+	}
+
+	task = std::move(pQueue->tasks.back());
+	pQueue->tasks.pop_back();
+
+	return true;
+}
+
+static bool StealTask(ThreadPool &pool, int nIndex, Task &task)
+{
+	int nCount = (int)pool.queues.size();
+
+	for (int nOffset = 1; nOffset < nCount; nOffset++) {
+		WorkQueue *pQueue = pool.queues[(nIndex + nOffset) % nCount];
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+
+		if (pQueue->tasks.empty() == false) {
+			task = std::move(pQueue->tasks.front());
+			pQueue->tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void WorkerThread(ThreadPool *pPool, int nIndex)
+{
+	nWorkerIndex = nIndex;
+
+	while (true) {
+		Task task;
+
+		if (PopTask(*pPool, nIndex, task) || StealTask(*pPool, nIndex, task)) {
+			task();
+
+			if (--pPool->nPending == 0) {
+				std::lock_guard<std::mutex> lock(pPool->mutex);
+				pPool->condition.notify_all();
+			}
+
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(pPool->mutex);
+
+		if (pPool->bExit) {
+			break;
+		}
+
+		// Submitters notify under this mutex, but the queues are checked without it, so never sleep for long
+		pPool->condition.wait_for(lock, std::chrono::milliseconds(1));
+	}
+}
+
+void ThreadPoolCreate(ThreadPool &pool, int nThreads)
+{
+	if (nThreads <= 0) {
+		nThreads = (std::max)(1, (int)std::thread::hardware_concurrency());
+	}
+
+	for (int nIndex = 0; nIndex < nThreads; nIndex++) {
+		pool.queues.push_back(new WorkQueue);
+	}
+
+	for (int nIndex = 0; nIndex < nThreads; nIndex++) {
+		pool.threads.push_back(std::thread(WorkerThread, &pool, nIndex));
+	}
+}
+
+void ThreadPoolDestroy(ThreadPool &pool)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.bExit = true;
+		pool.condition.notify_all();
+	}
+
+	for (auto &itThread : pool.threads) {
+		itThread.join();
+	}
+
+	for (const auto &itQueue : pool.queues) {
+		delete itQueue;
+	}
+
+	pool.threads.clear();
+	pool.queues.clear();
+}
+
+void ThreadPoolSubmit(ThreadPool &pool, Task task)
+{
+	int nIndex = nWorkerIndex >= 0 ? nWorkerIndex : (int)(dwNextQueue++ % pool.queues.size());
+
+	pool.nPending++;
+
+	{
+		std::lock_guard<std::mutex> lock(pool.queues[nIndex]->mutex);
+		pool.queues[nIndex]->tasks.push_back(std::move(task));
+	}
+
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	pool.condition.notify_all();
+}
+
+void ThreadPoolWait(ThreadPool &pool)
+{
+	std::unique_lock<std::mutex> lock(pool.mutex);
+
+	while (pool.nPending > 0) {
+		pool.condition.wait(lock);
+	}
+}
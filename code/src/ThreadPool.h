@@ -0,0 +1,47 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+typedef std::function<void(void)> Task;
+
+typedef struct WorkQueue {
+	std::mutex mutex;
+	std::deque<Task> tasks; // The owner pops from the back, thieves take from the front
+} WorkQueue;
+
+// Work-stealing pool, every worker owns a queue and steals from the others when its own runs dry
+typedef struct ThreadPool {
+	ThreadPool(void)
+		: nPending(0)
+		, bExit(false)
+	{
+
+	}
+
+	std::vector<std::thread> threads;
+	std::vector<WorkQueue*> queues;
+
+	std::atomic<int> nPending; // Submitted tasks that have not finished yet
+	std::atomic<bool> bExit;
+
+	std::mutex mutex;
+	std::condition_variable condition; // Signals new work to idle workers and completion to ThreadPoolWait
+} ThreadPool;
+
+
+void ThreadPoolCreate(ThreadPool &pool, int nThreads); // nThreads <= 0 uses every hardware thread
+void ThreadPoolDestroy(ThreadPool &pool);
+
+// Tasks submitted from a worker go to its own queue, the others are spread over all queues
+void ThreadPoolSubmit(ThreadPool &pool, Task task);
+void ThreadPoolWait(ThreadPool &pool);
+
+#endif
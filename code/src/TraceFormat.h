@@ -0,0 +1,80 @@
+#ifndef _TRACE_FORMAT_H_
+#define _TRACE_FORMAT_H_
+
+// Binary trace layout, shared by the recorder and offline readers.
+//
+// File:  TraceFileHeader, then fixed size chunks until the end of the file.
+// Chunk: TraceChunkHeader, the method IDs on the thread's stack when the chunk was started
+//        (outermost first, varints), then events. Only the first dwUsed bytes are valid.
+// Event: one tag byte followed by varints. Timestamps are deltas from the previous event
+//        of the same chunk, the first one is relative to qwBaseTick. A thread's next chunk
+//        uses the tick of the last event in its previous chunk as qwBaseTick.
+//
+//   TRACE_TAG_ENTER        delta, method ID
+//   TRACE_TAG_LEAVE        delta, method ID
+//   TRACE_TAG_ALLOCATION   delta, class ID, size
+//   TRACE_TAG_GC           delta, event, generation
+//   TRACE_TAG_METHOD_NAME  method ID, length, bytes (once per method and trace)
+//   TRACE_TAG_CLASS_NAME   class ID, length, bytes (once per class and trace)
+
+#define TRACE_FILE_MAGIC  0x5254504d // "MPTR"
+#define TRACE_CHUNK_MAGIC 0x4b4e4843 // "CHNK"
+#define TRACE_VERSION     1
+
+#define TRACE_CHUNK_SIZE  (1024 * 1024)
+#define TRACE_MAX_VARINT  10
+
+#define TRACE_TAG_ENTER       1
+#define TRACE_TAG_LEAVE       2
+#define TRACE_TAG_ALLOCATION  3
+#define TRACE_TAG_GC          4
+#define TRACE_TAG_METHOD_NAME 5
+#define TRACE_TAG_CLASS_NAME  6
+
+
+typedef struct TraceFileHeader {
+	unsigned int dwMagic;
+	unsigned int dwVersion;
+	unsigned int dwChunkSize;
+	unsigned int dwReserved;
+	unsigned long long qwFrequency; // Clock ticks per second
+} TraceFileHeader;
+
+typedef struct TraceChunkHeader {
+	unsigned int dwMagic;
+	unsigned int dwThreadID;
+	volatile unsigned int dwUsed; // Committed bytes including this header, stored after the data it covers
+	unsigned int dwStackDepth;
+	unsigned long long qwBaseTick;
+} TraceChunkHeader;
+
+
+inline unsigned char* TraceWriteVarint(unsigned char *pBuffer, unsigned long long qwValue)
+{
+	while (qwValue >= 0x80) {
+		*pBuffer++ = (unsigned char)(qwValue | 0x80);
+		qwValue >>= 7;
+	}
+
+	*pBuffer++ = (unsigned char)qwValue;
+	return pBuffer;
+}
+
+// Returns NULL when the varint runs past pEnd
+inline const unsigned char* TraceReadVarint(const unsigned char *pBuffer, const unsigned char *pEnd, unsigned long long &qwValue)
+{
+	qwValue = 0;
+
+	for (int nShift = 0; pBuffer < pEnd && nShift < 64; nShift += 7) {
+		unsigned char byte = *pBuffer++;
+		qwValue |= (unsigned long long)(byte & 0x7f) << nShift;
+
+		if ((byte & 0x80) == 0) {
+			return pBuffer;
+		}
+	}
+
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,236 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include "XmlWriter.h"
+
+
+static void Flush(XmlWriter &writer)
+{
+	if (writer.nSize > 0 && fwrite(writer.pBuffer, 1, writer.nSize, writer.pFile) != writer.nSize) {
+		writer.bError = true;
+	}
+
+	writer.nSize = 0;
+}
+
+static void Write(XmlWriter &writer, const char *pData, size_t nLength)
+{
+	if (writer.pFile == NULL) {
+		return;
+	}
+
+	if (writer.nSize + nLength > XML_BUFFER_SIZE) {
+		Flush(writer);
+
+		if (nLength > XML_BUFFER_SIZE) {
+			writer.bError |= fwrite(pData, 1, nLength, writer.pFile) != nLength;
+			return;
+		}
+	}
+
+	memcpy(writer.pBuffer + writer.nSize, pData, nLength);
+	writer.nSize += nLength;
+}
+
+static void Write(XmlWriter &writer, const char *szText)
+{
+	Write(writer, szText, strlen(szText));
+}
+
+static void WriteIndent(XmlWriter &writer)
+{
+	static const char szIndent[] = "                                                                "; // 4 * XML_MAX_DEPTH
+	Write(writer, szIndent, 4 * writer.nDepth);
+}
+
+// Same entities as TinyXML, control characters become hexadecimal references
+static void WriteEscaped(XmlWriter &writer, const char *szValue)
+{
+	const char *szRun = szValue;
+	const char *szChar = szValue;
+
+	for (; *szChar; szChar++) {
+		unsigned char c = (unsigned char)*szChar;
+		const char *szEntity = NULL;
+		char reference[7] = { '&', '#', 'x', '0', '0', ';', 0 };
+
+		switch (c) {
+		case '&': szEntity = "&amp;"; break;
+		case '<': szEntity = "&lt;"; break;
+		case '>': szEntity = "&gt;"; break;
+		case '\"': szEntity = "&quot;"; break;
+		case '\'': szEntity = "&apos;"; break;
+		default:
+			if (c < 32) {
+				reference[3] = "0123456789ABCDEF"[c >> 4];
+				reference[4] = "0123456789ABCDEF"[c & 0xf];
+				szEntity = reference;
+			}
+			break;
+		}
+
+		if (szEntity) {
+			Write(writer, szRun, szChar - szRun);
+			Write(writer, szEntity);
+			szRun = szChar + 1;
+		}
+	}
+
+	Write(writer, szRun, szChar - szRun);
+}
+
+static char* FormatUnsigned(char *pEnd, unsigned long long qwValue)
+{
+	do {
+		*--pEnd = (char)('0' + qwValue % 10);
+		qwValue /= 10;
+	} while (qwValue);
+
+	return pEnd;
+}
+
+static void BeginAttribute(XmlWriter &writer, const char *szName)
+{
+	Write(writer, " ", 1);
+	Write(writer, szName);
+	Write(writer, "=\"", 2);
+}
+
+bool XmlOpen(XmlWriter &writer, const char *szFileName)
+{
+	writer.pFile = fopen(szFileName, "w");
+	writer.pBuffer = writer.pFile ? (char *)malloc(XML_BUFFER_SIZE) : NULL;
+	writer.nSize = 0;
+	writer.nDepth = 0;
+	writer.bOpenTag = false;
+	writer.bError = writer.pFile == NULL || writer.pBuffer == NULL;
+
+	if (writer.pFile && writer.pBuffer == NULL) {
+		fclose(writer.pFile);
+		writer.pFile = NULL;
+	}
+
+	return writer.bError == false;
+}
+
+bool XmlClose(XmlWriter &writer)
+{
+	if (writer.pFile) {
+		Flush(writer);
+		writer.bError |= fclose(writer.pFile) != 0;
+	}
+
+	free(writer.pBuffer);
+
+	writer.pFile = NULL;
+	writer.pBuffer = NULL;
+
+	return writer.bError == false;
+}
+
+void XmlBeginElement(XmlWriter &writer, const char *szName)
+{
+	if (writer.nDepth >= XML_MAX_DEPTH) {
+		writer.bError = true;
+		return;
+	}
+
+	if (writer.bOpenTag) {
+		Write(writer, ">", 1);
+	}
+
+	if (writer.nDepth > 0) {
+		Write(writer, "\n", 1);
+	}
+
+	WriteIndent(writer);
+	Write(writer, "<", 1);
+	Write(writer, szName);
+
+	writer.elements[writer.nDepth++] = szName;
+	writer.bOpenTag = true;
+}
+
+void XmlEndElement(XmlWriter &writer)
+{
+	if (writer.nDepth == 0) {
+		return;
+	}
+
+	writer.nDepth--;
+
+	if (writer.bOpenTag) {
+		Write(writer, " />", 3);
+	}
+	else {
+		Write(writer, "\n", 1);
+		WriteIndent(writer);
+		Write(writer, "</", 2);
+		Write(writer, writer.elements[writer.nDepth]);
+		Write(writer, ">", 1);
+	}
+
+	if (writer.nDepth == 0) {
+		Write(writer, "\n", 1);
+	}
+
+	writer.bOpenTag = false;
+}
+
+void XmlAttributeString(XmlWriter &writer, const char *szName, const char *szValue)
+{
+	BeginAttribute(writer, szName);
+	WriteEscaped(writer, szValue);
+	Write(writer, "\"", 1);
+}
+
+void XmlAttributeInt(XmlWriter &writer, const char *szName, long long nValue)
+{
+	char digits[24];
+	char *pEnd = digits + sizeof(digits);
+	char *pBegin = FormatUnsigned(pEnd, nValue < 0 ? 0ULL - (unsigned long long)nValue : (unsigned long long)nValue);
+
+	if (nValue < 0) {
+		*--pBegin = '-';
+	}
+
+	BeginAttribute(writer, szName);
+	Write(writer, pBegin, pEnd - pBegin);
+	Write(writer, "\"", 1);
+}
+
+void XmlAttributeFloat(XmlWriter &writer, const char *szName, float fValue)
+{
+	char digits[64];
+	char *pEnd = digits + sizeof(digits);
+	char *pBegin = pEnd;
+
+	// A float significand times 10^6 is exact in a double, so rounding it to an integer matches printf
+	double fScaled = fabs((double)fValue * 1000000.0);
+
+	if (fScaled < 9.0e15) {
+		unsigned long long qwScaled = (unsigned long long)llrint(fScaled);
+		char *pFraction = FormatUnsigned(pEnd, qwScaled % 1000000);
+
+		while (pFraction > pEnd - 6) {
+			*--pFraction = '0';
+		}
+
+		*--pFraction = '.';
+		pBegin = FormatUnsigned(pFraction, qwScaled / 1000000);
+
+		if (std::signbit(fValue)) {
+			*--pBegin = '-';
+		}
+	}
+	else {
+		int nLength = snprintf(digits, sizeof(digits), "%f", fValue); // Huge values, infinities and NaN
+		pBegin = digits;
+		pEnd = digits + (nLength > 0 && nLength < (int)sizeof(digits) ? nLength : 0);
+	}
+
+	BeginAttribute(writer, szName);
+	Write(writer, pBegin, pEnd - pBegin);
+	Write(writer, "\"", 1);
+}
@@ -0,0 +1,48 @@
+#ifndef _XML_WRITER_H_
+#define _XML_WRITER_H_
+
+#include <stdio.h>
+
+// Streaming XML output in the layout TinyXML prints (4 space indent, childless elements as <X />),
+// written through one large buffer so a report never exists as a document in memory
+
+#define XML_BUFFER_SIZE (1024 * 1024)
+#define XML_MAX_DEPTH 16
+
+
+typedef struct XmlWriter {
+	XmlWriter(void)
+		: pFile(NULL)
+		, pBuffer(NULL)
+		, nSize(0)
+		, nDepth(0)
+		, bOpenTag(false)
+		, bError(false)
+	{
+
+	}
+
+	FILE *pFile;
+	char *pBuffer;
+	size_t nSize;
+
+	int nDepth;
+	const char *elements[XML_MAX_DEPTH]; // Names of the open elements, must outlive the element
+	bool bOpenTag; // The start tag of the innermost element still lacks its '>'
+
+	bool bError;
+} XmlWriter;
+
+
+bool XmlOpen(XmlWriter &writer, const char *szFileName);
+bool XmlClose(XmlWriter &writer); // Returns false if anything failed to reach the file
+
+void XmlBeginElement(XmlWriter &writer, const char *szName);
+void XmlEndElement(XmlWriter &writer);
+
+// Attributes go between XmlBeginElement and the first child
+void XmlAttributeString(XmlWriter &writer, const char *szName, const char *szValue);
+void XmlAttributeInt(XmlWriter &writer, const char *szName, long long nValue);
+void XmlAttributeFloat(XmlWriter &writer, const char *szName, float fValue); // Same digits as printf("%f")
+
+#endif
@@ -1,11 +1,16 @@
 #ifndef __MONO_PROFILER_H_
 #define __MONO_PROFILER_H_
 
+#include <math.h>
 #include <map>
-#include <stack>
+#include <new>
+#include <string>
 #include <vector>
-#include "tinyxml.h"
-#include "tinystr.h"
+#include "Arena.h"
+#include "Clock.h"
+#include "CallTree.h"
+#include "Report.h"
+#include "TraceFormat.h"
 #include "MonoProfiler.h"
 
 
@@ -67,6 +72,12 @@ typedef void GHashTable;
 typedef void MonoMemPool;
 typedef void GSList;
 typedef void LastCallerInfo;
+typedef void MonoJitInfo;
+typedef void MonoDomain;
+typedef void MonoThread;
+typedef void MonoProfilerCallContext;
+typedef void *MonoProfilerHandle;
+typedef gint32 mono_bool;
 
 struct MonoType;
 struct MonoClass;
@@ -157,6 +168,22 @@ typedef enum {
 	MONO_GC_EVENT_POST_START_WORLD
 } MonoGCEvent;
 
+typedef enum {
+	MONO_PROFILER_CALL_INSTRUMENTATION_NONE = 0,
+	MONO_PROFILER_CALL_INSTRUMENTATION_ENTER = 1 << 1,
+	MONO_PROFILER_CALL_INSTRUMENTATION_ENTER_CONTEXT = 1 << 2,
+	MONO_PROFILER_CALL_INSTRUMENTATION_LEAVE = 1 << 3,
+	MONO_PROFILER_CALL_INSTRUMENTATION_LEAVE_CONTEXT = 1 << 4,
+	MONO_PROFILER_CALL_INSTRUMENTATION_TAIL_CALL = 1 << 5,
+	MONO_PROFILER_CALL_INSTRUMENTATION_EXCEPTION_LEAVE = 1 << 6
+} MonoProfilerCallInstrumentationFlags;
+
+typedef enum {
+	MONO_PROFILER_SAMPLE_MODE_NONE = 0,
+	MONO_PROFILER_SAMPLE_MODE_PROCESS = 1,
+	MONO_PROFILER_SAMPLE_MODE_REAL = 2
+} MonoProfilerSampleMode;
+
 
 typedef struct {
 	glong tv_sec;
@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CallTree.h"
+#include "Report.h"
+#include "TraceFormat.h"
+#include "ThreadPool.h"
+
+
+// Rebuilds the Dump report from a binary trace. Chunks are replayed independently on a work-stealing
+// pool, each into its own calling context tree, then the trees of every thread are merged pairwise.
+//
+// usage: TraceAnalyzer <trace file> <report file> [-details] [-begin seconds] [-end seconds] [-top count] [-minshare fraction] [-threads count]
+
+typedef struct TraceFile {
+	TraceFile(void)
+		: pData(NULL)
+		, qwSize(0)
+#if defined(_WIN32)
+		, hFile(INVALID_HANDLE_VALUE)
+		, hMapping(NULL)
+#endif
+	{
+
+	}
+
+	const unsigned char *pData;
+	unsigned long long qwSize;
+
+#if defined(_WIN32)
+	HANDLE hFile;
+	HANDLE hMapping;
+#endif
+} TraceFile;
+
+typedef struct ChunkResult {
+	ChunkResult(void)
+		: dwThreadID(0)
+		, bCorrupt(false)
+	{
+
+	}
+
+	DWORD dwThreadID;
+	CallTree callTree;
+
+	std::vector<std::pair<DWORD, std::string>> methodNames;
+	std::vector<std::pair<DWORD, std::string>> classNames;
+
+	bool bCorrupt;
+} ChunkResult;
+
+static double dSecondsPerTick = 0.0;
+static std::vector<std::string> methodNames; // [Method ID, name]
+static std::vector<std::string> classNames; // [Class ID, name]
+
+
+static bool OpenTrace(const char *szFileName, TraceFile &traceFile)
+{
+#if defined(_WIN32)
+	traceFile.hFile = CreateFileA(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (traceFile.hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(traceFile.hFile, &size);
+	traceFile.qwSize = size.QuadPart;
+
+	traceFile.hMapping = CreateFileMappingA(traceFile.hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	traceFile.pData = traceFile.hMapping ? (const unsigned char *)MapViewOfFile(traceFile.hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+	int fd = open(szFileName, O_RDONLY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat status;
+	fstat(fd, &status);
+	traceFile.qwSize = status.st_size;
+
+	void *pData = traceFile.qwSize ? mmap(NULL, traceFile.qwSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	traceFile.pData = pData != MAP_FAILED ? (const unsigned char *)pData : NULL;
+	close(fd);
+#endif
+
+	return traceFile.pData != NULL;
+}
+
+static void CloseTrace(TraceFile &traceFile)
+{
+#if defined(_WIN32)
+	if (traceFile.pData) UnmapViewOfFile(traceFile.pData);
+	if (traceFile.hMapping) CloseHandle(traceFile.hMapping);
+	if (traceFile.hFile != INVALID_HANDLE_VALUE) CloseHandle(traceFile.hFile);
+#else
+	if (traceFile.pData) munmap((void *)traceFile.pData, traceFile.qwSize);
+#endif
+
+	traceFile.pData = NULL;
+}
+
+static const char* GetMethodName(DWORD dwMethodID)
+{
+	return dwMethodID < methodNames.size() && methodNames[dwMethodID].empty() == false ? methodNames[dwMethodID].c_str() : "<unknown>";
+}
+
+static const char* GetObjectName(DWORD dwClassID)
+{
+	return dwClassID < classNames.size() && classNames[dwClassID].empty() == false ? classNames[dwClassID].c_str() : "<unknown>";
+}
+
+static double GetSeconds(unsigned long long qwTicks)
+{
+	return qwTicks * dSecondsPerTick;
+}
+
+// Times are clipped to [qwBegin, qwEnd], frames still open at the end of the chunk are closed at its last
+// event. A thread's next chunk starts at that tick with the same stack, so the per-chunk times add up exactly.
+static void ReplayChunk(const TraceChunkHeader *pChunk, DWORD dwChunkSize, unsigned long long qwBegin, unsigned long long qwEnd, ChunkResult *pResult)
+{
+	const unsigned char *pBuffer = (const unsigned char *)(pChunk + 1);
+	const unsigned char *pEnd = (const unsigned char *)pChunk + std::min((DWORD)pChunk->dwUsed, dwChunkSize);
+
+	bool bTimeline = pChunk->qwBaseTick <= qwEnd; // Later chunks only contribute names
+	unsigned long long qwTick = pChunk->qwBaseTick;
+	unsigned long long qwValue;
+
+	MethodStack *pMethodStack = new MethodStack;
+	CreateCallTree(pResult->callTree);
+	MethodSample *pMethodSample = pResult->callTree.pRoot;
+	pResult->dwThreadID = pChunk->dwThreadID;
+
+	for (DWORD dwIndex = 0; dwIndex < pChunk->dwStackDepth && pBuffer; dwIndex++) {
+		if ((pBuffer = TraceReadVarint(pBuffer, pEnd, qwValue)) && bTimeline && pMethodStack->dwDepth < MAX_STACK_DEPTH) {
+			pMethodSample = GetChild(pResult->callTree, pMethodSample, (DWORD)qwValue);
+			pMethodStack->frames[pMethodStack->dwDepth++] = MethodFrame((DWORD)qwValue, pMethodSample, std::min(std::max(qwTick, qwBegin), qwEnd));
+		}
+	}
+
+	while (pBuffer && pBuffer < pEnd) {
+		unsigned char tag = *pBuffer++;
+		unsigned long long qwDelta, qwID, qwArg;
+
+		switch (tag) {
+		case TRACE_TAG_ENTER:
+		case TRACE_TAG_LEAVE:
+			if ((pBuffer = TraceReadVarint(pBuffer, pEnd, qwDelta)) && (pBuffer = TraceReadVarint(pBuffer, pEnd, qwID)) && bTimeline) {
+				qwTick += qwDelta;
+
+				if (tag == TRACE_TAG_ENTER) {
+					DWORD dwDepth = pMethodStack->dwDepth;
+					EnterMethod(*pMethodStack, &pResult->callTree, (DWORD)qwID, std::min(std::max(qwTick, qwBegin), qwEnd));
+
+					// Calls outside the range keep their frame for the structure but are not counted
+					if (pMethodStack->dwDepth > dwDepth && (qwTick < qwBegin || qwTick > qwEnd)) {
+						pMethodStack->frames[dwDepth].pMethodSample->dwCount--;
+					}
+				}
+				else {
+					LeaveMethod(*pMethodStack, (DWORD)qwID, std::min(std::max(qwTick, qwBegin), qwEnd));
+				}
+			}
+			break;
+
+		case TRACE_TAG_ALLOCATION:
+			if ((pBuffer = TraceReadVarint(pBuffer, pEnd, qwDelta)) && (pBuffer = TraceReadVarint(pBuffer, pEnd, qwID)) && (pBuffer = TraceReadVarint(pBuffer, pEnd, qwArg)) && bTimeline) {
+				qwTick += qwDelta;
+
+				if (qwTick >= qwBegin && qwTick <= qwEnd) {
+					RecordAllocation(pResult->callTree, *pMethodStack, (DWORD)qwID, (DWORD)qwArg, 1.0);
+				}
+			}
+			break;
+
+		case TRACE_TAG_GC:
+			if ((pBuffer = TraceReadVarint(pBuffer, pEnd, qwDelta)) && (pBuffer = TraceReadVarint(pBuffer, pEnd, qwID)) && (pBuffer = TraceReadVarint(pBuffer, pEnd, qwArg))) {
+				qwTick += qwDelta;
+			}
+			break;
+
+		case TRACE_TAG_METHOD_NAME:
+		case TRACE_TAG_CLASS_NAME:
+			if ((pBuffer = TraceReadVarint(pBuffer, pEnd, qwID)) && (pBuffer = TraceReadVarint(pBuffer, pEnd, qwArg))) {
+				if (qwArg > (unsigned long long)(pEnd - pBuffer)) {
+					pBuffer = NULL;
+					break;
+				}
+
+				std::vector<std::pair<DWORD, std::string>> &names = tag == TRACE_TAG_METHOD_NAME ? pResult->methodNames : pResult->classNames;
+				names.push_back(std::make_pair((DWORD)qwID, std::string((const char *)pBuffer, (size_t)qwArg)));
+				pBuffer += qwArg;
+			}
+			break;
+
+		default:
+			pBuffer = NULL;
+			break;
+		}
+	}
+
+	pResult->bCorrupt = pBuffer == NULL;
+
+	UnwindMethods(*pMethodStack, 0, std::min(std::max(qwTick, qwBegin), qwEnd));
+	delete pMethodStack;
+}
+
+static void AddNames(std::vector<std::string> &names, const std::vector<std::pair<DWORD, std::string>> &definitions)
+{
+	for (const auto &itDefinition : definitions) {
+		if (itDefinition.first >= names.size()) {
+			names.resize(itDefinition.first + 1);
+		}
+
+		names[itDefinition.first] = itDefinition.second;
+	}
+}
+
+// Slot 0 and IDs that never showed up in the trace stay empty
+static int CountNames(const std::vector<std::string> &names)
+{
+	return (int)std::count_if(names.begin(), names.end(), [](const std::string &name) { return name.empty() == false; });
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		printf("usage: %s <trace file> <report file> [-details] [-begin seconds] [-end seconds] [-top count] [-minshare fraction] [-threads count]\n", argv[0]);
+		return 1;
+	}
+
+	bool bDetails = false;
+	double dBegin = 0.0;
+	double dEnd = -1.0;
+	int nThreads = 0;
+	ReportLimits limits;
+
+	for (int nIndex = 3; nIndex < argc; nIndex++) {
+		if (strcmp(argv[nIndex], "-details") == 0) {
+			bDetails = true;
+		}
+		else if (strcmp(argv[nIndex], "-begin") == 0 && nIndex + 1 < argc) {
+			dBegin = atof(argv[++nIndex]);
+		}
+		else if (strcmp(argv[nIndex], "-end") == 0 && nIndex + 1 < argc) {
+			dEnd = atof(argv[++nIndex]);
+		}
+		else if (strcmp(argv[nIndex], "-top") == 0 && nIndex + 1 < argc) {
+			limits.dwTopCount = std::max(atoi(argv[++nIndex]), 0);
+		}
+		else if (strcmp(argv[nIndex], "-minshare") == 0 && nIndex + 1 < argc) {
+			limits.fMinShare = std::max(atof(argv[++nIndex]), 0.0);
+		}
+		else if (strcmp(argv[nIndex], "-threads") == 0 && nIndex + 1 < argc) {
+			nThreads = atoi(argv[++nIndex]);
+		}
+		else {
+			printf("Unknown option %s\n", argv[nIndex]);
+			return 1;
+		}
+	}
+
+	TraceFile traceFile;
+
+	if (OpenTrace(argv[1], traceFile) == false) {
+		printf("Open trace file %s fail!!!\n", argv[1]);
+		return 1;
+	}
+
+	const TraceFileHeader *pHeader = (const TraceFileHeader *)traceFile.pData;
+
+	if (traceFile.qwSize < sizeof(TraceFileHeader) || pHeader->dwMagic != TRACE_FILE_MAGIC || pHeader->dwVersion != TRACE_VERSION || pHeader->dwChunkSize < sizeof(TraceChunkHeader)) {
+		printf("%s is not a trace file!!!\n", argv[1]);
+		CloseTrace(traceFile);
+		return 1;
+	}
+
+	dSecondsPerTick = pHeader->qwFrequency ? 1.0 / pHeader->qwFrequency : 0.0;
+
+	std::vector<const TraceChunkHeader*> chunks;
+	unsigned long long qwStartTick = ULLONG_MAX;
+
+	for (unsigned long long qwOffset = sizeof(TraceFileHeader); qwOffset + sizeof(TraceChunkHeader) <= traceFile.qwSize; qwOffset += pHeader->dwChunkSize) {
+		const TraceChunkHeader *pChunk = (const TraceChunkHeader *)(traceFile.pData + qwOffset);
+
+		if (pChunk->dwMagic != TRACE_CHUNK_MAGIC) {
+			break;
+		}
+
+		// The last chunk may be cut short by the end of the file
+		if (qwOffset + pChunk->dwUsed > traceFile.qwSize) {
+			break;
+		}
+
+		chunks.push_back(pChunk);
+		qwStartTick = std::min(qwStartTick, pChunk->qwBaseTick);
+	}
+
+	unsigned long long qwBegin = chunks.empty() ? 0 : qwStartTick + (unsigned long long)(std::max(dBegin, 0.0) * pHeader->qwFrequency);
+	unsigned long long qwEnd = chunks.empty() || dEnd < 0.0 ? ULLONG_MAX : qwStartTick + (unsigned long long)(dEnd * pHeader->qwFrequency);
+
+	ThreadPool pool;
+	ThreadPoolCreate(pool, nThreads);
+
+	std::vector<ChunkResult> results(chunks.size());
+
+	for (size_t nIndex = 0; nIndex < chunks.size(); nIndex++) {
+		const TraceChunkHeader *pChunk = chunks[nIndex];
+		ChunkResult *pResult = &results[nIndex];
+		DWORD dwChunkSize = pHeader->dwChunkSize;
+
+		ThreadPoolSubmit(pool, [=]() { ReplayChunk(pChunk, dwChunkSize, qwBegin, qwEnd, pResult); });
+	}
+
+	ThreadPoolWait(pool);
+
+	std::map<DWORD, std::vector<CallTree*>> threadTrees;
+	DWORD dwCorrupt = 0;
+
+	for (auto &itResult : results) {
+		AddNames(methodNames, itResult.methodNames);
+		AddNames(classNames, itResult.classNames);
+		threadTrees[itResult.dwThreadID].push_back(&itResult.callTree);
+		dwCorrupt += itResult.bCorrupt ? 1 : 0;
+	}
+
+	// Pairwise merge rounds, all threads at once, until every thread is down to one tree
+	while (true) {
+		bool bMerged = false;
+
+		for (auto &itThreadTrees : threadTrees) {
+			std::vector<CallTree*> &trees = itThreadTrees.second;
+
+			for (size_t nIndex = 0; nIndex + 1 < trees.size(); nIndex += 2) {
+				CallTree *pCallTree = trees[nIndex];
+				CallTree *pOther = trees[nIndex + 1];
+
+				ThreadPoolSubmit(pool, [=]() { MergeMethodSample(*pCallTree, pCallTree->pRoot, pOther->pRoot); DestroyCallTree(*pOther); });
+				bMerged = true;
+			}
+		}
+
+		if (bMerged == false) {
+			break;
+		}
+
+		ThreadPoolWait(pool);
+
+		for (auto &itThreadTrees : threadTrees) {
+			std::vector<CallTree*> &trees = itThreadTrees.second;
+
+			for (size_t nIndex = 0; nIndex * 2 < trees.size(); nIndex++) {
+				trees[nIndex] = trees[nIndex * 2];
+			}
+
+			trees.resize((trees.size() + 1) / 2);
+		}
+	}
+
+	std::vector<MethodSample*> methodSamples;
+	std::vector<const MethodSample*> roots;
+	FlatTotals flatTotals;
+
+	for (const auto &itThreadTrees : threadTrees) {
+		CollectMethodSamples(itThreadTrees.second[0]->pRoot, methodSamples);
+		roots.push_back(itThreadTrees.second[0]->pRoot);
+	}
+
+	ComputeFlatTotals(pool, roots, flatTotals);
+	ThreadPoolDestroy(pool);
+
+	static const ReportSource reportSource = { GetMethodName, GetObjectName, GetSeconds };
+
+	XmlWriter writer;
+	XmlOpen(writer, argv[2]);
+
+	XmlBeginElement(writer, "Report");
+	{
+		if (bDetails) {
+			ReportCallTree(writer, methodSamples, reportSource);
+		}
+
+		ReportTime(writer, methodSamples, bDetails, limits, reportSource);
+		ReportMemory(writer, methodSamples, bDetails, limits, reportSource);
+		ReportFlat(writer, flatTotals, limits, reportSource);
+	}
+	XmlEndElement(writer);
+
+	bool bSaved = XmlClose(writer);
+
+	printf("%d chunks, %d threads, %d methods, %d classes", (int)chunks.size(), (int)threadTrees.size(), CountNames(methodNames), CountNames(classNames));
+	printf(dwCorrupt ? ", %d corrupt chunks\n" : "\n", dwCorrupt);
+
+	for (const auto &itThreadTrees : threadTrees) {
+		DestroyCallTree(*itThreadTrees.second[0]);
+	}
+
+	CloseTrace(traceFile);
+
+	if (bSaved == false) {
+		printf("Save report %s fail!!!\n", argv[2]);
+		return 1;
+	}
+
+	return 0;
+}
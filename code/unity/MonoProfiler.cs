@@ -3,17 +3,66 @@
 
 public class MonoProfilerEditor : Editor
 {
+    public const int PROFILER_MODE_INSTRUMENT = 0;
+    public const int PROFILER_MODE_SAMPLING = 1;
+    public const int PROFILER_MODE_STATISTICAL = 2;
+
+    public const int PIPELINE_POLICY_DROP = 0;
+    public const int PIPELINE_POLICY_SPIN = 1;
+
+    [DllImport("MonoProfiler")]
+    public static extern void SetMode(int nMode, int nFrequency);
+    [DllImport("MonoProfiler")]
+    public static extern void SetPipeline(int nRingSize, int nPolicy);
+    [DllImport("MonoProfiler")]
+    public static extern void SetAllocationSampling(int nMeanBytes);
+    [DllImport("MonoProfiler")]
+    public static extern void AddFilter(string szPattern, bool bInclude);
+    [DllImport("MonoProfiler")]
+    public static extern void ClearFilters();
     [DllImport("MonoProfiler")]
     public static extern void Init(string szMonoMoudleFileName);
     [DllImport("MonoProfiler")]
     public static extern void Clear();
     [DllImport("MonoProfiler")]
+    public static extern void SetDumpLimits(int nTopCount, float fMinShare);
+    [DllImport("MonoProfiler")]
     public static extern void Dump(string szDumpFileName, bool bDetails);
+    [DllImport("MonoProfiler")]
+    public static extern int DumpAsync(string szDumpFileName, bool bDetails);
+    [DllImport("MonoProfiler")]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public static extern bool IsDumpDone(int nDumpID);
+    [DllImport("MonoProfiler")]
+    public static extern void DumpDelta(string szDumpFileName, bool bDetails);
+    [DllImport("MonoProfiler")]
+    public static extern void StartTrace(string szTraceFileName, int nMaxSizeMB);
+    [DllImport("MonoProfiler")]
+    public static extern void StopTrace();
+    [DllImport("MonoProfiler")]
+    public static extern void StartAutoDump(string szFilePrefix, int nIntervalSeconds, int nKeepCount, bool bDetails);
+    [DllImport("MonoProfiler")]
+    public static extern void StopAutoDump();
 
 
     [@MenuItem("MonoProfiler/Init")]
     public static void MonoProfilerInit()
     {
+        SetMode(PROFILER_MODE_INSTRUMENT, 0);
+        Init("C:\\Program Files (x86)\\Unity\\Editor\\Data\\Mono\\EmbedRuntime\\mono.dll");
+    }
+
+    [@MenuItem("MonoProfiler/Init Sampling")]
+    public static void MonoProfilerInitSampling()
+    {
+        SetMode(PROFILER_MODE_SAMPLING, 1000);
+        Init("C:\\Program Files (x86)\\Unity\\Editor\\Data\\Mono\\EmbedRuntime\\mono.dll");
+    }
+
+    [@MenuItem("MonoProfiler/Init Statistical")]
+    public static void MonoProfilerInitStatistical()
+    {
+        SetMode(PROFILER_MODE_STATISTICAL, 0);
         Init("C:\\Program Files (x86)\\Unity\\Editor\\Data\\Mono\\EmbedRuntime\\mono.dll");
     }
 
@@ -34,4 +83,40 @@ public static void MonoProfilerDumpDetails()
     {
         Dump("dump_details.xml", true);
     }
+
+    [@MenuItem("MonoProfiler/Dump Details Async")]
+    public static void MonoProfilerDumpDetailsAsync()
+    {
+        DumpAsync("dump_details.xml", true);
+    }
+
+    [@MenuItem("MonoProfiler/Dump Delta")]
+    public static void MonoProfilerDumpDelta()
+    {
+        DumpDelta("dump_delta.xml", false);
+    }
+
+    [@MenuItem("MonoProfiler/Start Trace")]
+    public static void MonoProfilerStartTrace()
+    {
+        StartTrace("trace.bin", 256);
+    }
+
+    [@MenuItem("MonoProfiler/Stop Trace")]
+    public static void MonoProfilerStopTrace()
+    {
+        StopTrace();
+    }
+
+    [@MenuItem("MonoProfiler/Start Auto Dump")]
+    public static void MonoProfilerStartAutoDump()
+    {
+        StartAutoDump("autodump", 60, 60, false);
+    }
+
+    [@MenuItem("MonoProfiler/Stop Auto Dump")]
+    public static void MonoProfilerStopAutoDump()
+    {
+        StopAutoDump();
+    }
 }